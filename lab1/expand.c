@@ -0,0 +1,268 @@
+/* Command substitution, $(command line).
+ *
+ * The command line inside $( ) runs in a subshell with its standard
+ * output connected to a pipe, and the shell collects the output in a
+ * memory buffer that grows as needed. Trailing newlines are removed.
+ * Substitutions in program arguments are split into words at whitespace;
+ * those in redirection targets are not.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "parse.h"
+#include "jobs.h"
+#include "lsh.h"
+#include "expand.h"
+
+#define TRUE 1
+#define FALSE 0
+
+#define CAPTURESIZE 4096
+
+/*
+ * Find the ) that closes the substitution starting at s ("$(...")
+ *
+ * Returns NULL if it is never closed.
+ */
+static char *SubstitutionEnd(char *s) {
+    int depth = 0;
+
+    for (s++; *s != '\0'; s++) {
+        if (*s == '(') {
+            depth++;
+        } else if (*s == ')' && --depth == 0) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Run a command line in a subshell and return everything it wrote to
+ * standard output, without trailing newlines. The result is malloc'd.
+ */
+char *CaptureOutput(char *line) {
+    int out[2];
+    size_t size = CAPTURESIZE;
+    size_t len = 0;
+    char *buf = malloc(size);
+    ssize_t n;
+
+    if (pipe2(out, O_CLOEXEC) == -1) {
+        perror("Could not capture output");
+        *buf = '\0';
+        return buf;
+    }
+
+    Job *job = AddJob(strdup(line), FALSE);
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) { // In child
+        Command cmd;
+
+        JobChildInit(job);
+        EnterSubshell();
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        close(out[1]);
+        stripwhite(line);
+        exit(RunCommandLine(parse(line, &cmd), &cmd));
+    }
+    close(out[1]);
+
+    if (child == -1) {
+        perror("Could not capture output");
+        RemoveJob(job);
+    } else {
+        AddJobProcess(job, child, line);
+        // One read loop, doubling the buffer whenever it fills up
+        while ((n = read(out[0], buf + len, size - len)) > 0 || (n < 0 && errno == EINTR)) {
+            if (n > 0 && (len += n) == size) {
+                size *= 2;
+                buf = realloc(buf, size);
+            }
+        }
+        FinishJob(job, FALSE);
+    }
+    close(out[0]);
+
+    while (len > 0 && buf[len - 1] == '\n') {
+        len--;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+/*
+ * Append len bytes of s to a growing string
+ */
+static void Append(char **str, size_t *len, size_t *size, char *s, size_t n) {
+    if (*len + n + 1 > *size) {
+        while (*len + n + 1 > *size) {
+            *size = *size ? *size * 2 : 64;
+        }
+        *str = realloc(*str, *size);
+    }
+    memcpy(*str + *len, s, n);
+    *len += n;
+    (*str)[*len] = '\0';
+}
+
+/*
+ * Expand every substitution in word, with the output spliced in as is.
+ * The result is malloc'd.
+ */
+char *ExpandWord(char *word) {
+    char *result = NULL;
+    size_t len = 0, size = 0;
+    char *s, *end;
+
+    Append(&result, &len, &size, "", 0);
+    while ((s = strstr(word, "$(")) != NULL && (end = SubstitutionEnd(s)) != NULL) {
+        Append(&result, &len, &size, word, s - word);
+
+        char *inner = strndup(s + 2, end - s - 2);
+        char *output = CaptureOutput(inner);
+        Append(&result, &len, &size, output, strlen(output));
+        free(inner);
+        free(output);
+
+        word = end + 1;
+    }
+    Append(&result, &len, &size, word, strlen(word));
+    return result;
+}
+
+/*
+ * Expand the substitutions in a list of program arguments
+ *
+ * Substituted output is split into words at whitespace; text around a
+ * substitution sticks to its first and last word. Returns a malloc'd NULL
+ * terminated list of malloc'd words, or NULL if there was nothing to
+ * substitute.
+ */
+char **ExpandWords(char **words) {
+    char **result;
+    int count = 0, max = 8;
+    char **w;
+
+    for (w = words; *w && strstr(*w, "$(") == NULL; w++);
+    if (*w == NULL) {
+        return NULL;
+    }
+
+    result = malloc(max * sizeof(char *));
+    for (w = words; *w; w++) {
+        char *word = *w;
+        char *field = NULL;
+        size_t len = 0, size = 0;
+        char *s, *end;
+
+        while (TRUE) {
+            char *output = NULL;
+            if ((s = strstr(word, "$(")) == NULL || (end = SubstitutionEnd(s)) == NULL) {
+                s = end = word + strlen(word);
+            } else {
+                char *inner = strndup(s + 2, end - s - 2);
+                output = CaptureOutput(inner);
+                free(inner);
+            }
+
+            // Literal text before the substitution
+            if (s > word || field == NULL) {
+                Append(&field, &len, &size, word, s - word);
+            }
+
+            for (char *o = output; o != NULL && *o; o++) {
+                if (!isspace(*o)) {
+                    Append(&field, &len, &size, o, 1);
+                } else if (len > 0) { // End of a word
+                    if (count + 2 > max) {
+                        max *= 2;
+                        result = realloc(result, max * sizeof(char *));
+                    }
+                    result[count++] = field;
+                    field = NULL;
+                    len = size = 0;
+                }
+            }
+            free(output);
+
+            if (*end == '\0') {
+                break;
+            }
+            word = end + 1;
+        }
+
+        // Drop words that were only an empty substitution
+        if (field != NULL && (len > 0 || strstr(*w, "$(") == NULL)) {
+            if (count + 2 > max) {
+                max *= 2;
+                result = realloc(result, max * sizeof(char *));
+            }
+            result[count++] = field;
+        } else {
+            free(field);
+        }
+    }
+    result[count] = NULL;
+    return result;
+}
+
+void FreeWords(char **words) {
+    for (char **w = words; *w; w++) {
+        free(*w);
+    }
+    free(words);
+}
+
+/*
+ * Expand the substitutions in the arguments and redirection targets of
+ * cmd, replacing them in place. Here-strings are not split into words.
+ *
+ * Returns what was allocated, to be freed with FreeExpansion once the
+ * command has run.
+ */
+Expansion *ExpandCommand(Command *cmd) {
+    Expansion *expansion = NULL;
+    Expansion *e;
+
+    for (Pgm *pgm = cmd->pgm; pgm != NULL; pgm = pgm->next) {
+        char **words = ExpandWords(pgm->pgmlist);
+        if (words != NULL) {
+            e = calloc(1, sizeof(Expansion));
+            e->words = pgm->pgmlist = words;
+            e->next = expansion;
+            expansion = e;
+        }
+    }
+
+    for (Redirect *r = cmd->redirects; r != NULL; r = r->next) {
+        if (r->file != NULL && strstr(r->file, "$(") != NULL) {
+            e = calloc(1, sizeof(Expansion));
+            e->file = r->file = ExpandWord(r->file);
+            e->next = expansion;
+            expansion = e;
+        }
+    }
+    return expansion;
+}
+
+void FreeExpansion(Expansion *expansion) {
+    while (expansion != NULL) {
+        Expansion *next = expansion->next;
+        if (expansion->words != NULL) {
+            FreeWords(expansion->words);
+        }
+        free(expansion->file);
+        free(expansion);
+        expansion = next;
+    }
+}
@@ -0,0 +1,17 @@
+typedef struct expansion {
+    char **words; /* Expanded argument list of a program */
+    char *file;   /* Expanded redirection target */
+    struct expansion *next;
+} Expansion;
+
+extern char *CaptureOutput(char *);
+
+extern char *ExpandWord(char *);
+
+extern char **ExpandWords(char **);
+
+extern void FreeWords(char **);
+
+extern Expansion *ExpandCommand(Command *);
+
+extern void FreeExpansion(Expansion *);
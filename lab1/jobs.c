@@ -0,0 +1,587 @@
+/* Job table and job control for lsh.
+ *
+ * Every pipeline started by the shell becomes a job with its own process
+ * group. Children are never waited for directly: a SIGCHLD handler only
+ * writes a byte to a self-pipe, and ReapChildren collects every pending
+ * state change with non-blocking waitpid calls from the main loop, and
+ * from the input loop while the shell sits at the prompt.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "jobs.h"
+
+#define TRUE 1
+#define FALSE 0
+
+static Job *job_list = NULL;
+static int sigchld_pipe[2] = {-1, -1};
+static int interactive;
+static int job_control;
+static pid_t shell_pgid;
+static volatile sig_atomic_t interrupted;
+
+/*
+ * Signal handler
+ *
+ * Wake up the main loop, the actual reaping is done by ReapChildren
+ */
+static void HandleSigchld(int sig) {
+    int saved_errno = errno;
+    write(sigchld_pipe[1], "c", 1);
+    errno = saved_errno;
+}
+
+/*
+ * Signal handler
+ *
+ * Lets the user break out of the wait builtin with ^C
+ */
+static void InterruptWait(int sig) {
+    interrupted = TRUE;
+}
+
+/*
+ * Create the SIGCHLD self-pipe and install its handler
+ */
+static void InitSigchldPipe(void) {
+    struct sigaction action;
+
+    if (pipe2(sigchld_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        perror("Could not create SIGCHLD pipe");
+        exit(1);
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = HandleSigchld;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &action, NULL);
+}
+
+/*
+ * Set up the SIGCHLD self-pipe and the signal dispositions the shell needs
+ * to hand the terminal to its jobs.
+ */
+void InitJobControl(void) {
+    interactive = isatty(STDIN_FILENO);
+    job_control = TRUE;
+    shell_pgid = getpgrp();
+
+    InitSigchldPipe();
+
+    if (interactive) {
+        signal(SIGTSTP, SIG_IGN);
+        signal(SIGTTIN, SIG_IGN);
+        signal(SIGTTOU, SIG_IGN);
+    }
+}
+
+/*
+ * Start over with an empty job table in a forked child of the shell.
+ *
+ * Jobs of a subshell stay in the process group of the subshell, so the
+ * job that runs the subshell can be stopped or killed as a whole.
+ * Must be called after JobChildInit, which closes the inherited pipe.
+ */
+void InitSubshell(void) {
+    job_list = NULL;
+    interactive = FALSE;
+    job_control = FALSE;
+    InitSigchldPipe();
+}
+
+/*
+ * File descriptor that becomes readable when a child changes state,
+ * for callers that wait on other descriptors as well
+ */
+int JobEventFd(void) {
+    return sigchld_pipe[0];
+}
+
+/*
+ * Create a new job and append it to the job table.
+ *
+ * The job takes ownership of description, which must be malloc'd.
+ */
+Job *AddJob(char *description, int background) {
+    Job *job = malloc(sizeof(Job));
+    Job **last = &job_list;
+    int id = 1;
+
+    while (*last != NULL) {
+        if ((*last)->id >= id) {
+            id = (*last)->id + 1;
+        }
+        last = &(*last)->next;
+    }
+
+    job->id = id;
+    job->pgid = 0;
+    job->procs = NULL;
+    job->num_procs = 0;
+    job->max_procs = 0;
+    job->state = JOB_RUNNING;
+    job->background = background;
+    job->changed = FALSE;
+    job->timed = FALSE;
+    job->description = description;
+    job->next = NULL;
+    *last = job;
+    return job;
+}
+
+/*
+ * Register a freshly forked child with its job (parent side).
+ *
+ * The first child becomes the process group leader. Both the parent and
+ * the child move the child into the group, whichever runs first wins.
+ * name is copied, it is only used to label the process in reports.
+ */
+void AddJobProcess(Job *job, pid_t pid, char *name) {
+    Process *proc;
+
+    if (job->num_procs == job->max_procs) {
+        job->max_procs = job->max_procs ? job->max_procs * 2 : 4;
+        job->procs = realloc(job->procs, job->max_procs * sizeof(Process));
+    }
+    proc = &job->procs[job->num_procs++];
+    memset(proc, 0, sizeof(Process));
+    proc->pid = pid;
+    proc->state = PROC_RUNNING;
+    proc->name = strdup(name);
+    clock_gettime(CLOCK_MONOTONIC, &proc->start);
+
+    if (job->pgid == 0) {
+        job->pgid = pid;
+    }
+    if (!job_control) {
+        return;
+    }
+    setpgid(pid, job->pgid);
+    if (interactive && !job->background) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    }
+}
+
+/*
+ * Unlink a job from the job table and free it
+ */
+void RemoveJob(Job *job) {
+    Job **link = &job_list;
+    while (*link != NULL && *link != job) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = job->next;
+    }
+    for (int i = 0; i < job->num_procs; i++) {
+        free(job->procs[i].name);
+    }
+    free(job->procs);
+    free(job->description);
+    free(job);
+}
+
+/*
+ * Look up a job from a job spec ("%2" or "2").
+ *
+ * Without a spec the most recently started job is returned.
+ */
+Job *FindJob(char *spec) {
+    Job *job = job_list;
+    Job *last = NULL;
+    int id;
+
+    if (spec == NULL) {
+        while (job != NULL) {
+            last = job;
+            job = job->next;
+        }
+        return last;
+    }
+
+    if (*spec == '%') {
+        spec++;
+    }
+    id = atoi(spec);
+    while (job != NULL && job->id != id) {
+        job = job->next;
+    }
+    return job;
+}
+
+/*
+ * Prepare a forked child for exec (child side).
+ *
+ * Moves the child into the job's process group, gives it the terminal if
+ * it is a foreground job and restores default signal handling.
+ */
+void JobChildInit(Job *job) {
+    pid_t pgid = job->pgid ? job->pgid : getpid();
+
+    if (job_control) {
+        setpgid(0, pgid);
+        if (interactive && !job->background) {
+            tcsetpgrp(STDIN_FILENO, pgid);
+        }
+    }
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+
+    close(sigchld_pipe[0]);
+    close(sigchld_pipe[1]);
+}
+
+/*
+ * Derive the state of a job from the state of its processes
+ */
+static int ComputeJobState(Job *job) {
+    int i;
+    int state = JOB_DONE;
+
+    for (i = 0; i < job->num_procs; i++) {
+        if (job->procs[i].state == PROC_RUNNING) {
+            return JOB_RUNNING;
+        } else if (job->procs[i].state == PROC_STOPPED) {
+            state = JOB_STOPPED;
+        }
+    }
+    return state;
+}
+
+/*
+ * Record a wait status and resource usage reported for pid
+ */
+static void UpdateProcess(pid_t pid, int status, struct rusage *usage) {
+    Job *job;
+    int i;
+
+    for (job = job_list; job != NULL; job = job->next) {
+        for (i = 0; i < job->num_procs; i++) {
+            if (job->procs[i].pid != pid) {
+                continue;
+            }
+
+            if (WIFSTOPPED(status)) {
+                job->procs[i].state = PROC_STOPPED;
+            } else if (WIFCONTINUED(status)) {
+                job->procs[i].state = PROC_RUNNING;
+            } else {
+                job->procs[i].state = PROC_EXITED;
+                job->procs[i].status = status;
+                job->procs[i].usage = *usage;
+                clock_gettime(CLOCK_MONOTONIC, &job->procs[i].end);
+            }
+
+            int state = ComputeJobState(job);
+            if (state != job->state) {
+                job->state = state;
+                job->changed = TRUE;
+            }
+            return;
+        }
+    }
+}
+
+/*
+ * Collect every pending child state change without blocking.
+ *
+ * The self-pipe is drained before polling waitpid, so a SIGCHLD arriving
+ * after the last waitpid call always leaves a byte behind for the next
+ * WaitForSigchld.
+ */
+void ReapChildren(void) {
+    char buf[64];
+    int status;
+    struct rusage usage;
+    pid_t pid;
+
+    while (read(sigchld_pipe[0], buf, sizeof(buf)) > 0);
+
+    while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0) {
+        UpdateProcess(pid, status, &usage);
+    }
+}
+
+/*
+ * Block until a SIGCHLD arrives or a signal interrupts the wait
+ */
+static void WaitForSigchld(void) {
+    struct pollfd pfd;
+    pfd.fd = sigchld_pipe[0];
+    pfd.events = POLLIN;
+    poll(&pfd, 1, -1);
+}
+
+/*
+ * Exit status of a job, taken from the last stage of its pipeline.
+ *
+ * Pipelines are started from the right, so that stage is the first
+ * process of the job. Signals are reported as 128 + signal number.
+ */
+int JobExitStatus(Job *job) {
+    int status;
+
+    if (job->num_procs == 0) {
+        return 0;
+    }
+
+    status = job->procs[0].status;
+    if (job->procs[0].state == PROC_STOPPED) {
+        return 128 + SIGTSTP;
+    } else if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return 0;
+}
+
+/*
+ * Human readable state of a job, for jobs and notifications
+ */
+static void DescribeJobState(Job *job, char *buf, size_t size) {
+    int status = job->num_procs ? job->procs[0].status : 0;
+
+    switch (job->state) {
+        case JOB_RUNNING:
+            snprintf(buf, size, "Running");
+            break;
+        case JOB_STOPPED:
+            snprintf(buf, size, "Stopped");
+            break;
+        default:
+            if (WIFSIGNALED(status)) {
+                snprintf(buf, size, "%s", strsignal(WTERMSIG(status)));
+            } else if (WEXITSTATUS(status) != 0) {
+                snprintf(buf, size, "Exit %d", WEXITSTATUS(status));
+            } else {
+                snprintf(buf, size, "Done");
+            }
+            break;
+    }
+}
+
+static void PrintJob(Job *job) {
+    char state[64];
+    DescribeJobState(job, state, sizeof(state));
+    printf("[%d] %-24s %s\n", job->id, state, job->description);
+}
+
+static double Seconds(struct timeval *tv) {
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static double Elapsed(struct timespec *from, struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static void PrintTimes(double real, double user, double sys, long maxrss, long nvcsw, long nivcsw, char *name) {
+    fprintf(stderr, "%9.3f %9.3f %9.3f %10ld %8ld %8ld  %s\n", real, user, sys, maxrss, nvcsw, nivcsw, name);
+}
+
+/*
+ * Print wall time, CPU time, peak memory and context switches of every
+ * stage of a finished job and of the job as a whole (the time keyword).
+ *
+ * Wall time runs from fork until the process was reaped, the total from
+ * the first fork until the last stage was reaped.
+ */
+void ReportJobTimes(Job *job) {
+    struct timespec *start = NULL;
+    struct timespec *end = NULL;
+    double user = 0, sys = 0;
+    long maxrss = 0, nvcsw = 0, nivcsw = 0;
+    int i;
+
+    if (job->num_procs == 0) {
+        return;
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "%9s %9s %9s %10s %8s %8s  %s\n", "real", "user", "sys", "maxrss(KB)", "vcsw", "ivcsw", "stage");
+    // Pipelines are started from the right, print the stages in typed order
+    for (i = job->num_procs - 1; i >= 0; i--) {
+        Process *proc = &job->procs[i];
+        struct rusage *usage = &proc->usage;
+
+        PrintTimes(Elapsed(&proc->start, &proc->end), Seconds(&usage->ru_utime), Seconds(&usage->ru_stime),
+                   usage->ru_maxrss, usage->ru_nvcsw, usage->ru_nivcsw, proc->name);
+
+        if (start == NULL || Elapsed(&proc->start, start) > 0) {
+            start = &proc->start;
+        }
+        if (end == NULL || Elapsed(end, &proc->end) > 0) {
+            end = &proc->end;
+        }
+        user += Seconds(&usage->ru_utime);
+        sys += Seconds(&usage->ru_stime);
+        if (usage->ru_maxrss > maxrss) {
+            maxrss = usage->ru_maxrss;
+        }
+        nvcsw += usage->ru_nvcsw;
+        nivcsw += usage->ru_nivcsw;
+    }
+    PrintTimes(Elapsed(start, end), user, sys, maxrss, nvcsw, nivcsw, "total");
+}
+
+/*
+ * Wait until job is no longer running.
+ *
+ * A foreground job gets the terminal while it runs; a job that stops is
+ * moved to the background. Foreground jobs that finish are removed from
+ * the job table, background jobs stay until the user has been notified.
+ * ^C only interrupts waiting for a background job, which is then still
+ * running when this returns. Returns the exit status of the job.
+ */
+int WaitForJob(Job *job, int foreground) {
+    struct sigaction action, old_action;
+    int status;
+
+    if (foreground && interactive) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    } else if (!foreground) {
+        interrupted = FALSE;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = InterruptWait;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, &old_action);
+    }
+
+    while (TRUE) {
+        ReapChildren();
+        if (job->state != JOB_RUNNING || (!foreground && interrupted)) {
+            break;
+        }
+        WaitForSigchld();
+    }
+
+    if (foreground && interactive) {
+        tcsetpgrp(STDIN_FILENO, shell_pgid);
+    } else if (!foreground) {
+        sigaction(SIGINT, &old_action, NULL);
+        interrupted = FALSE;
+    }
+
+    status = JobExitStatus(job);
+    if (foreground && job->state == JOB_STOPPED) {
+        job->background = TRUE;
+        job->changed = FALSE;
+        printf("\n");
+        PrintJob(job);
+    } else if (foreground && job->state == JOB_DONE) {
+        if (job->timed) {
+            ReportJobTimes(job);
+        }
+        RemoveJob(job);
+    }
+    return status;
+}
+
+/*
+ * Resume a stopped job, in the foreground or the background
+ *
+ * Returns the exit status of a foreground job
+ */
+int ContinueJob(Job *job, int foreground) {
+    int i;
+
+    for (i = 0; i < job->num_procs; i++) {
+        if (job->procs[i].state == PROC_STOPPED) {
+            job->procs[i].state = PROC_RUNNING;
+        }
+    }
+    job->state = ComputeJobState(job);
+    job->background = !foreground;
+    job->changed = FALSE;
+
+    if (foreground && interactive) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    }
+    kill(job_control ? -job->pgid : job->pgid, SIGCONT);
+
+    if (foreground) {
+        printf("%s\n", job->description);
+        return WaitForJob(job, TRUE);
+    }
+    printf("[%d] %s &\n", job->id, job->description);
+    return 0;
+}
+
+/*
+ * Report background jobs that changed state since the last prompt and
+ * forget the ones that have finished.
+ */
+void NotifyJobs(void) {
+    Job *job = job_list;
+    Job *next;
+
+    ReapChildren();
+    while (job != NULL) {
+        next = job->next;
+        if (job->background && job->changed) {
+            PrintJob(job);
+            job->changed = FALSE;
+            if (job->state == JOB_DONE) {
+                if (job->timed) {
+                    ReportJobTimes(job);
+                }
+                RemoveJob(job);
+            }
+        }
+        job = next;
+    }
+}
+
+/*
+ * The jobs builtin, finished jobs are removed once listed
+ */
+void PrintJobs(void) {
+    Job *job = job_list;
+    Job *next;
+
+    ReapChildren();
+    while (job != NULL) {
+        next = job->next;
+        PrintJob(job);
+        job->changed = FALSE;
+        if (job->state == JOB_DONE) {
+            if (job->timed) {
+                ReportJobTimes(job);
+            }
+            RemoveJob(job);
+        }
+        job = next;
+    }
+}
+
+/*
+ * The wait builtin without arguments, wait for every running job
+ */
+void WaitForAllJobs(void) {
+    Job *job;
+
+    for (job = job_list; job != NULL; job = job->next) {
+        if (job->state == JOB_RUNNING) {
+            WaitForJob(job, FALSE);
+            if (job->state == JOB_RUNNING) { // Interrupted by ^C
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define PROC_RUNNING 0
+#define PROC_STOPPED 1
+#define PROC_EXITED 2
+
+#define JOB_RUNNING 0
+#define JOB_STOPPED 1
+#define JOB_DONE 2
+
+typedef struct process {
+    pid_t pid;
+    int state;
+    int status; /* Raw wait status, valid once state is PROC_EXITED */
+    char *name;
+    struct timespec start; /* CLOCK_MONOTONIC at fork */
+    struct timespec end;   /* CLOCK_MONOTONIC when reaped */
+    struct rusage usage;   /* From wait4, valid once state is PROC_EXITED */
+} Process;
+
+typedef struct job {
+    int id;
+    pid_t pgid;
+    Process *procs;
+    int num_procs;
+    int max_procs;
+    int state;
+    int background;
+    int changed; /* State changed since the user was last told about it */
+    int timed;   /* Report resource usage when done (the time keyword) */
+    char *description;
+    struct job *next;
+} Job;
+
+extern void InitJobControl(void);
+
+extern void InitSubshell(void);
+
+extern int JobEventFd(void);
+
+extern Job *AddJob(char *, int);
+
+extern void AddJobProcess(Job *, pid_t, char *);
+
+extern void RemoveJob(Job *);
+
+extern Job *FindJob(char *);
+
+extern void JobChildInit(Job *);
+
+extern void ReapChildren(void);
+
+extern int WaitForJob(Job *, int);
+
+extern int ContinueJob(Job *, int);
+
+extern void NotifyJobs(void);
+
+extern void PrintJobs(void);
+
+extern void WaitForAllJobs(void);
+
+extern int JobExitStatus(Job *);
+
+extern void ReportJobTimes(Job *);
@@ -16,6 +16,8 @@
  * All the best 
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,37 +27,55 @@
 #include <wait.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 #include "parse.h"
+#include "jobs.h"
+#include "lsh.h"
+#include "parallel.h"
+#include "stream.h"
+#include "expand.h"
 #include "unistd.h"
 
 #define TRUE 1
 #define FALSE 0
 
-int * children;
-int numChildren;
+#define NOT_BUILTIN (-1)
+
+pid_t foreground_pgid;
+int subshell = FALSE;
 
 void KillChildrenOnSignal(int);
 
-void RunCommand(int, Command *);
+int *OpenRedirects(Redirect *);
+
+void CloseRedirects(Redirect *, int *);
+
+int ApplyRedirects(Redirect *, int *, int, int);
+
+static int RunPipeline(Command *);
+
+static int OpenString(char *);
+
+static int ReadInputChar(FILE *);
 
 void DebugPrintCommand(int, Command *);
 
 void PrintPgm(Pgm *);
 
-void stripwhite(char *);
-
 void HandleBackgroundFinish(int);
 
 char** ParseInput(char*);
 
 int main(void) {
     signal(SIGINT, SIG_IGN);
-    signal(SIGCHLD,SIG_IGN);
+    InitJobControl();
+    rl_getc_function = ReadInputChar;
     Command cmd;
     int parse_result;
 
     while (TRUE) {
         char *line;
+        NotifyJobs();
         line = readline("> ");
 
         /* If EOF encountered, exit shell */
@@ -68,7 +88,7 @@ int main(void) {
         if (*line) {
             add_history(line);
             parse_result = parse(line, &cmd);
-            RunCommand(parse_result, &cmd);
+            RunCommandLine(parse_result, &cmd);
         }
 
         /* Clear memory */
@@ -77,6 +97,38 @@ int main(void) {
     return 0;
 }
 
+/*
+ * Read a character of input for readline, reaping children that change
+ * state while the shell waits for it.
+ *
+ * Background jobs are otherwise only reaped before the next prompt, which
+ * would count the time spent idle at the prompt in the real time of a
+ * timed background job.
+ */
+static int ReadInputChar(FILE *stream) {
+    struct pollfd pfds[2];
+
+    pfds[0].fd = fileno(stream);
+    pfds[0].events = POLLIN;
+    pfds[1].fd = JobEventFd();
+    pfds[1].events = POLLIN;
+    for (;;) {
+        if (poll(pfds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (pfds[1].revents & POLLIN) {
+            ReapChildren();
+        }
+        if (pfds[0].revents != 0) {
+            break;
+        }
+    }
+    return rl_getc(stream);
+}
+
 /*
  * Counts the number of commands in Pgm* list
  */
@@ -136,6 +188,145 @@ void handle_directory_error() {
     }
 }
 
+/*
+ * Open a pipe that reads back s and a newline, for a here-string
+ *
+ * The pipe is grown to hold the whole string when the kernel allows it, so
+ * the shell can fill it up front. Longer strings are written by a child.
+ * Returns the read end, or -1 on error.
+ */
+static int OpenString(char *s) {
+    size_t len = strlen(s);
+    int fds[2];
+
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        return -1;
+    }
+
+    if (len + 1 > (size_t) fcntl(fds[1], F_GETPIPE_SZ) && fcntl(fds[1], F_SETPIPE_SZ, len + 1) == -1) {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) { // In child, writes until the reader has taken it all
+            close(fds[0]);
+            write(fds[1], s, len);
+            write(fds[1], "\n", 1);
+            _exit(0);
+        }
+        close(fds[1]);
+        if (child == -1) {
+            close(fds[0]);
+            return -1;
+        }
+        return fds[0];
+    }
+
+    write(fds[1], s, len);
+    write(fds[1], "\n", 1);
+    close(fds[1]);
+    return fds[0];
+}
+
+/*
+ * Open the files of all file redirections
+ *
+ * The descriptors are moved above the ones a redirection can name (0-9)
+ * and closed on exec. Returns a malloc'd array with one descriptor per
+ * redirection (-1 where no file is involved), or NULL on error.
+ */
+int *OpenRedirects(Redirect *redirects) {
+    int count = 0;
+    int i;
+    Redirect *r;
+
+    for (r = redirects; r != NULL; r = r->next) {
+        count++;
+    }
+
+    int *fds = malloc((count + 1) * sizeof(int));
+    for (i = 0; i < count; i++) {
+        fds[i] = -1;
+    }
+
+    for (i = 0, r = redirects; r != NULL; r = r->next, i++) {
+        int fd;
+        switch (r->type) {
+            case REDIR_IN:
+                fd = open(r->file, O_RDONLY);
+                break;
+            case REDIR_OUT:
+                fd = creat(r->file, S_IRGRP | S_IRUSR | S_IWUSR | S_IWGRP | S_IROTH);
+                break;
+            case REDIR_APPEND:
+                fd = open(r->file, O_WRONLY | O_CREAT | O_APPEND, S_IRGRP | S_IRUSR | S_IWUSR | S_IWGRP | S_IROTH);
+                break;
+            case REDIR_STRING:
+                fd = OpenString(r->file);
+                break;
+            default:
+                continue;
+        }
+
+        if (fd == -1) {
+            handle_file_error();
+
+            // Cleanup and abort.
+            CloseRedirects(redirects, fds);
+            return NULL;
+        }
+        fds[i] = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+        close(fd);
+    }
+    return fds;
+}
+
+/*
+ * Close and free the descriptors from OpenRedirects
+ */
+void CloseRedirects(Redirect *redirects, int *fds) {
+    int i = 0;
+
+    for (Redirect *r = redirects; r != NULL; r = r->next, i++) {
+        if (fds[i] != -1) {
+            close(fds[i]);
+        }
+    }
+    free(fds);
+}
+
+/*
+ * Apply redirections in a child, after its pipes are in place
+ *
+ * Redirections are applied in the order they were given. Those of stdin
+ * only apply to the first stage of the pipeline and those of stdout only
+ * to the last stage, all others apply to every stage (so "2>&1" sends the
+ * stderr of each stage wherever its stdout goes).
+ * Returns FALSE on error.
+ */
+int ApplyRedirects(Redirect *redirects, int *fds, int first_stage, int last_stage) {
+    int i = 0;
+
+    for (Redirect *r = redirects; r != NULL; r = r->next, i++) {
+        if ((r->fd == STDIN_FILENO && !first_stage) || (r->fd == STDOUT_FILENO && !last_stage)) {
+            continue;
+        }
+        switch (r->type) {
+            case REDIR_DUP:
+                if (dup2(r->dupfd, r->fd) == -1) {
+                    fprintf(stderr, "%d: Bad file descriptor\n", r->dupfd);
+                    return FALSE;
+                }
+                break;
+            case REDIR_CLOSE:
+                close(r->fd);
+                break;
+            default:
+                dup2(fds[i], r->fd);
+                break;
+        }
+    }
+    return TRUE;
+}
+
 /*
  * Execute the command and handle potential errors
  */
@@ -153,50 +344,262 @@ void handle_command(char** command) {
 
 #define BUFFERSIZE 80
 
-/* Execute the given command(s). */
-void RunCommand(int parse_result, Command *cmd) {
-    int command_counter = CountCommands(cmd->pgm);
-    __pid_t* command_pids = malloc(command_counter * sizeof(__pid_t));
-    int curr_command_index = 0;
-    Pgm *pgm = cmd->pgm;
+/*
+ * Append the programs of a pipeline to buf, in the order they were typed
+ */
+static char *AppendPgm(char *buf, Pgm *p) {
+    if (p == NULL) {
+        return buf;
+    }
 
-    int last_in = STDIN_FILENO; // The input for the last command in the chain. (left-most command)
-    // Open file for redirected input and set file descriptor as input for last (left-most) command
-    if (cmd->rstdin) {
-        int input = open(cmd->rstdin, O_RDONLY);
-        if (input == -1) {
-            handle_file_error();
+    // The list is in reversed order so append the rest of it first
+    buf = AppendPgm(buf, p->next);
+    if (p->next != NULL) {
+        buf = stpcpy(buf, " | ");
+    }
+    for (char **pl = p->pgmlist; *pl; pl++) {
+        if (pl != p->pgmlist) {
+            *buf++ = ' ';
+        }
+        buf = stpcpy(buf, *pl);
+    }
+    return buf;
+}
 
-            // Cleanup and abort.
-            free(command_pids);
-            return;
+/*
+ * Build the text shown for the commands from cmd up to (not including) stop
+ */
+static char *DescribeCommands(Command *cmd, Command *stop) {
+    static const char *connectors[] = {"", "; ", " && ", " || "};
+    size_t size = 1;
+
+    for (Command *c = cmd; c != stop; c = c->next) {
+        size += 4;
+        for (Pgm *pgm = c->pgm; pgm != NULL; pgm = pgm->next) {
+            for (char **pl = pgm->pgmlist; *pl; pl++) {
+                size += strlen(*pl) + 1;
+            }
+            size += 3;
+        }
+    }
+
+    char *description = malloc(size);
+    char *end = description;
+    *end = '\0';
+    for (Command *c = cmd; c != stop; c = c->next) {
+        if (c != cmd) {
+            end = stpcpy(end, connectors[c->connector]);
+        }
+        end = AppendPgm(end, c->pgm);
+    }
+    return description;
+}
+
+/*
+ * Build the text shown for a command in the job table, e.g. "ls -l | wc"
+ */
+char *DescribeCommand(Command *cmd) {
+    return DescribeCommands(cmd, cmd->next);
+}
+
+/*
+ * Build the text shown for a whole command line, e.g. "make && ./a.out"
+ */
+char *DescribeCommandLine(Command *cmd) {
+    return DescribeCommands(cmd, NULL);
+}
+
+/*
+ * Run command if it is a built in command
+ *
+ * Returns the exit status of the built in command, or NOT_BUILTIN if the
+ * command has to be executed
+ */
+int RunBuiltin(char **command) {
+    int status = 0;
+
+    if (strcmp("exit", command[0]) == 0) {
+        exit(0);
+    } else if (strcmp("cd", command[0]) == 0) {
+        if (chdir(command[1]) == -1) {
+            handle_directory_error();
+            status = 1;
+        }
+    } else if (strcmp("jobs", command[0]) == 0) {
+        PrintJobs();
+    } else if (strcmp("fg", command[0]) == 0 || strcmp("bg", command[0]) == 0) {
+        int foreground = command[0][0] == 'f';
+        Job *job = FindJob(command[1]);
+        if (job == NULL) {
+            fprintf(stderr, "%s: No such job\n", command[0]);
+            status = 1;
+        } else if (job->state == JOB_DONE) {
+            fprintf(stderr, "%s: Job has terminated\n", command[0]);
+            status = 1;
         } else {
-            last_in = input;
+            if (foreground && !subshell) {
+                foreground_pgid = job->pgid;
+                signal(SIGINT, KillChildrenOnSignal);
+            }
+            status = ContinueJob(job, foreground);
+            if (foreground && !subshell) {
+                foreground_pgid = 0;
+                signal(SIGINT, SIG_IGN);
+            }
+        }
+    } else if (strcmp("wait", command[0]) == 0) {
+        if (command[1] == NULL) {
+            WaitForAllJobs();
+        }
+        for (char **spec = command + 1; *spec; spec++) {
+            Job *job = FindJob(*spec);
+            if (job == NULL) {
+                fprintf(stderr, "wait: No such job: %s\n", *spec);
+                status = 127;
+            } else {
+                status = WaitForJob(job, FALSE);
+                if (job->state == JOB_RUNNING) { // Interrupted by ^C
+                    break;
+                }
+            }
         }
+    } else {
+        return NOT_BUILTIN;
     }
+    return status;
+}
 
-    int child_in = STDIN_FILENO;
-    int child_out = STDOUT_FILENO;
-    // Open file for redirected output
-    if (cmd->rstdout) {
-        int out_pid = creat(cmd->rstdout, S_IRGRP | S_IRUSR | S_IWUSR | S_IWGRP | S_IROTH);
-        if (out_pid == -1) {
-            handle_file_error();
+/*
+ * Left-most program of a pipeline
+ */
+Pgm *FirstPgm(Command *cmd) {
+    Pgm *pgm = cmd->pgm;
+    while (pgm != NULL && pgm->next != NULL) {
+        pgm = pgm->next;
+    }
+    return pgm;
+}
 
-            // Cleanup and abort.
-            free(command_pids);
-            if (last_in != STDIN_FILENO) {
-                close(last_in);
+/*
+ * Execute a command line: commands joined by ;, &, && and ||
+ *
+ * Returns the exit status of the last command that was run
+ */
+int RunCommandLine(int parse_result, Command *cmd) {
+    int status = 0;
+
+    if (parse_result != 1) { // Syntax error, run nothing
+        return 2;
+    }
+
+    if (IsParallel(cmd)) {
+        return RunParallel(parse_result, cmd);
+    }
+
+    for (; cmd != NULL; cmd = cmd->next) {
+        if ((cmd->connector == CONNECT_AND && status != 0) ||
+            (cmd->connector == CONNECT_OR && status == 0)) {
+            continue;
+        }
+        status = RunCommand(parse_result, cmd);
+    }
+    return status;
+}
+
+/*
+ * Wait for a job that was just started, or report it if it runs in the background
+ *
+ * Returns the exit status of the job
+ */
+int FinishJob(Job *job, int background) {
+    int status;
+
+    if (background) {
+        if (!subshell) {
+            printf("[%d] %d\n", job->id, job->pgid);
+        }
+        return 0;
+    }
+
+    if (subshell) {
+        return WaitForJob(job, TRUE);
+    }
+
+    foreground_pgid = job->pgid;
+    signal(SIGINT, KillChildrenOnSignal);
+    status = WaitForJob(job, TRUE);
+    foreground_pgid = 0;
+    signal(SIGINT, SIG_IGN);
+    return status;
+}
+
+/*
+ * Turn a forked copy of the shell into a subshell
+ *
+ * The subshell gets a job table of its own and leaves process groups, the
+ * terminal and ^C handling to the shell that forked it.
+ */
+void EnterSubshell(void) {
+    InitSubshell();
+    subshell = TRUE;
+}
+
+/* Execute the given command(s). Returns the exit status of the pipeline. */
+int RunCommand(int parse_result, Command *cmd) {
+    // Command substitutions run first, in order, before any stage is started
+    Expansion *expansion = ExpandCommand(cmd);
+    int status;
+
+    for (Pgm *pgm = cmd->pgm; pgm != NULL; pgm = pgm->next) {
+        if (pgm->pgmlist[0] == NULL) { // Every word was an empty substitution
+            FreeExpansion(expansion);
+            if (cmd->pgm->next == NULL) {
+                return 0;
             }
-            return;
-        } else {
-            // Set the first output to the opened file
-            child_out = out_pid;
+            fprintf(stderr, "Empty command in pipeline\n");
+            return 2;
+        }
+    }
+
+    status = RunPipeline(cmd);
+    FreeExpansion(expansion);
+    return status;
+}
+
+/*
+ * Run the pipeline of cmd, once its substitutions are expanded
+ *
+ * Returns its exit status, or 0 for a background job.
+ */
+static int RunPipeline(Command *cmd) {
+    Job *job = NULL;
+    Pgm *pgm = cmd->pgm;
+    int status = 0;
+    int timed = FALSE;
+
+    // The time keyword, report the resource usage of the pipeline when done
+    Pgm *first = FirstPgm(cmd);
+    if (first != NULL && strcmp("time", first->pgmlist[0]) == 0) {
+        first->pgmlist++;
+        timed = TRUE;
+        if (*first->pgmlist == NULL) {
+            fprintf(stderr, "time: missing command\n");
+            return 2;
         }
     }
 
+    // Open redirected files once, in the shell, so every stage shares the same open file
+    int *redirect_fds = OpenRedirects(cmd->redirects);
+    if (redirect_fds == NULL) {
+        return 1;
+    }
+
+    int child_in = STDIN_FILENO;
+    int child_out = STDOUT_FILENO;
+
     while (pgm != NULL) { // loop trough commands (right to left)
         char** command = pgm->pgmlist;
+        int on_first_command = pgm == cmd->pgm; // right-most, its status is the status of the pipeline
         pgm = pgm->next;
         int on_last_command = pgm == NULL;
 
@@ -215,22 +618,32 @@ void RunCommand(int parse_result, Command *cmd) {
                 child_in = pipe_descriptor[0];
             }
         } else { // On last command
-            child_in = last_in;
+            child_in = STDIN_FILENO;
         }
 
-        // Built in commands
-        if (strcmp("exit", command[0]) == 0) {
-            exit(0);
-        } else if (strcmp("cd", command[0]) == 0) {
-            int status = chdir(command[1]);
-            if (status == -1) {
-                handle_directory_error();
+        int builtin_status = RunBuiltin(command);
+        if (builtin_status != NOT_BUILTIN) { // Built in commands
+            if (on_first_command) {
+                status = builtin_status;
+            }
+
+            if (child_in != STDIN_FILENO) {
+                close(child_in);
+            }
+
+            if (child_out != STDOUT_FILENO) {
+                close(child_out);
             }
-            command_counter = 0; // To avoid killing random processes
         } else { // Not built in command
+            if (job == NULL) { // Register the job before the first child can exit
+                job = AddJob(DescribeCommand(cmd), cmd->background);
+                job->timed = timed;
+            }
+
+            fflush(stdout); // Don't let the child flush our buffered output a second time
             __pid_t child = fork();
             if (child == 0) { // In child
-                signal(SIGINT, SIG_IGN);
+                JobChildInit(job);
 
                 if (!on_last_command && pipe_descriptor[1] != STDOUT_FILENO) {
                     close(pipe_descriptor[1]); // close write end of new pipe in child
@@ -246,8 +659,15 @@ void RunCommand(int parse_result, Command *cmd) {
                     close(child_out);
                 }
 
+                if (!ApplyRedirects(cmd->redirects, redirect_fds, on_last_command, on_first_command)) {
+                    exit(1);
+                }
+
+                if (IsStreamBuiltin(command)) { // cat and tee stream without exec
+                    exit(RunStreamBuiltin(command));
+                }
                 handle_command(command);
-                exit(0);
+                exit(127);
             } else { // In parent
                 if (child_in != STDIN_FILENO) {
                     close(child_in);
@@ -257,43 +677,31 @@ void RunCommand(int parse_result, Command *cmd) {
                     close(child_out);
                 }
 
-                command_pids[curr_command_index] = child;
-
-                if (!on_last_command) {
-                    child_out = pipe_descriptor[1]; // set output of next command to write end of pipe
-                }
+                AddJobProcess(job, child, command[0]);
             }
         }
 
-        curr_command_index++;
+        if (!on_last_command) {
+            child_out = pipe_descriptor[1]; // set output of next command to write end of pipe
+        }
     }
 
-    if (!cmd->background) {
-        children = command_pids;
-        numChildren = command_counter;
-        signal(SIGINT, KillChildrenOnSignal);
-        int i = 0;
-        while (i < command_counter) {
-            int *exitcode = 0;
-            waitpid(command_pids[i], exitcode, WUNTRACED);
-            i++;
-        }
+    CloseRedirects(cmd->redirects, redirect_fds);
 
-        numChildren = 0;
-        signal(SIGINT, SIG_IGN);
+    if (job == NULL) { // Only built in commands, nothing to wait for
+        return status;
     }
-    free(command_pids);
+
+    return FinishJob(job, cmd->background);
 }
 /*
  * Signal handler
  *
- * Send kill signal to all children in global children variable
+ * Send kill signal to all processes in the foreground job
  */
 void KillChildrenOnSignal(int status) {
-    int i = 0;
-    while (i < numChildren) {
-        kill(children[i], SIGKILL);
-        i++;
+    if (foreground_pgid > 0) {
+        kill(-foreground_pgid, SIGKILL);
     }
 }
 
@@ -0,0 +1,16 @@
+/* Shell functions shared with the builtin modules.
+ * Include parse.h and jobs.h before this file. */
+
+extern int RunCommandLine(int, Command *);
+
+extern int RunCommand(int, Command *);
+
+extern int FinishJob(Job *, int);
+
+extern char *DescribeCommandLine(Command *);
+
+extern void EnterSubshell(void);
+
+extern Pgm *FirstPgm(Command *);
+
+extern void stripwhite(char *);
@@ -0,0 +1,351 @@
+/* The parallel builtin.
+ *
+ *   parallel [-j N] [-g] cmd1 ; cmd2 ; cmd3 ...
+ *   parallel [-j N] [-g] < file
+ *
+ * Runs every ';' separated command of the line (a pipeline, or a chain of
+ * them joined by && and ||) in a subshell of its own, with at most N of
+ * them running at a time. Without commands on the line, one command line
+ * is read per line of standard input instead. N defaults to the number of
+ * online CPUs. With -g the output of each command is collected and
+ * printed in one piece when it finishes, so output of concurrent commands
+ * does not interleave.
+ *
+ * The whole run is a single job of the shell: a coordinator subshell
+ * refills slots as commands finish and exits with the number of commands
+ * that failed (101 meaning more than 100).
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "parse.h"
+#include "jobs.h"
+#include "lsh.h"
+#include "parallel.h"
+
+#define TRUE 1
+#define FALSE 0
+
+#define READSIZE 4096
+
+typedef struct slot {
+    Job *job;       /* NULL when the slot is free */
+    int out;        /* Read end of the grouped output pipe, -1 when closed */
+    char *buf;      /* Output collected so far */
+    size_t len;
+    size_t size;
+} Slot;
+
+typedef struct source {
+    Command *next;  /* Next command of the line, NULL when exhausted */
+    FILE *in;       /* Command lines are read from here if not NULL */
+    char *line;     /* Line buffer for in */
+    size_t size;
+    Command cmd;    /* Parse result for the last line read */
+} Source;
+
+/*
+ * Check if the command line starts with the parallel builtin
+ */
+int IsParallel(Command *cmd) {
+    Pgm *pgm = FirstPgm(cmd);
+    return pgm != NULL && strcmp("parallel", pgm->pgmlist[0]) == 0;
+}
+
+/*
+ * Take the next command line to run, or NULL if there are none left
+ */
+static Command *NextCommandLine(Source *source) {
+    if (source->in == NULL) {
+        Command *first = source->next;
+        Command *last = first;
+        if (first == NULL) {
+            return NULL;
+        }
+
+        // A command line runs up to the next ; or &
+        while (last->next != NULL && last->next->connector != CONNECT_SEQ) {
+            last = last->next;
+        }
+        source->next = last->next;
+        last->next = NULL;
+        last->background = FALSE; // & only separates command lines here
+        first->connector = CONNECT_NONE;
+        return first;
+    }
+
+    while (getline(&source->line, &source->size, source->in) != -1) {
+        stripwhite(source->line);
+        if (*source->line == '\0') {
+            continue;
+        }
+        if (parse(source->line, &source->cmd) == 1) {
+            return &source->cmd;
+        }
+        fprintf(stderr, "parallel: could not parse: %s\n", source->line);
+    }
+    return NULL;
+}
+
+/*
+ * Start a command line in a subshell in slot
+ *
+ * Returns FALSE if the subshell could not be started
+ */
+static int StartSlot(Slot *slot, Command *cmd, int group, int null_stdin) {
+    int out[2];
+
+    if (group && pipe2(out, O_CLOEXEC) == -1) {
+        perror("parallel: pipe");
+        group = FALSE;
+    }
+
+    slot->job = AddJob(DescribeCommandLine(cmd), FALSE);
+    slot->len = 0;
+    slot->out = -1;
+
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) { // In child
+        JobChildInit(slot->job);
+        EnterSubshell();
+        if (null_stdin) { // Standard input holds the remaining command lines
+            int null = open("/dev/null", O_RDONLY);
+            dup2(null, STDIN_FILENO);
+            close(null);
+        }
+        if (group) {
+            dup2(out[1], STDOUT_FILENO);
+            dup2(out[1], STDERR_FILENO);
+            close(out[0]);
+            close(out[1]);
+        }
+        exit(RunCommandLine(1, cmd));
+    }
+
+    if (group) {
+        close(out[1]);
+        slot->out = out[0];
+    }
+    if (child == -1) {
+        perror("parallel: fork");
+        if (slot->out != -1) {
+            close(slot->out);
+            slot->out = -1;
+        }
+        RemoveJob(slot->job);
+        slot->job = NULL;
+        return FALSE;
+    }
+    AddJobProcess(slot->job, child, slot->job->description);
+    return TRUE;
+}
+
+/*
+ * Read whatever output is available from a slot's pipe
+ */
+static void ReadSlot(Slot *slot) {
+    if (slot->size - slot->len < READSIZE) {
+        slot->size = slot->size ? slot->size * 2 : 2 * READSIZE;
+        slot->buf = realloc(slot->buf, slot->size);
+    }
+
+    ssize_t n = read(slot->out, slot->buf + slot->len, slot->size - slot->len);
+    if (n <= 0) {
+        close(slot->out);
+        slot->out = -1;
+    } else {
+        slot->len += n;
+    }
+}
+
+/*
+ * Write the grouped output of a finished slot and free the slot.
+ *
+ * Returns the exit status of the command line that ran in it.
+ */
+static int FinishSlot(Slot *slot) {
+    int status = JobExitStatus(slot->job);
+    size_t written = 0;
+
+    while (written < slot->len) {
+        ssize_t n = write(STDOUT_FILENO, slot->buf + written, slot->len - written);
+        if (n <= 0) {
+            break;
+        }
+        written += n;
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "parallel: %s: exit %d\n", slot->job->description, status);
+    }
+    RemoveJob(slot->job);
+    slot->job = NULL;
+    return status;
+}
+
+/*
+ * Run the command lines with at most max_jobs at a time (coordinator side)
+ *
+ * Returns the number of command lines that failed, at most 101.
+ */
+static int Coordinate(Source *source, int max_jobs, int group) {
+    Slot *slots = calloc(max_jobs, sizeof(Slot));
+    struct pollfd *fds = malloc((max_jobs + 1) * sizeof(struct pollfd));
+    Command *cmd;
+    int running = 0;
+    int exhausted = FALSE;
+    int failed = 0;
+    int i;
+
+    while (!exhausted || running > 0) {
+        // Fill every free slot
+        for (i = 0; i < max_jobs && !exhausted; i++) {
+            if (slots[i].job != NULL) {
+                continue;
+            }
+            if ((cmd = NextCommandLine(source)) == NULL) {
+                exhausted = TRUE;
+            } else if (StartSlot(&slots[i], cmd, group, source->in != NULL)) {
+                running++;
+            } else {
+                failed++;
+            }
+        }
+
+        ReapChildren();
+
+        // A slot is free once its command is done and all its output is read
+        int finished = FALSE;
+        for (i = 0; i < max_jobs; i++) {
+            if (slots[i].job != NULL && slots[i].job->state == JOB_DONE && slots[i].out == -1) {
+                if (FinishSlot(&slots[i]) != 0) {
+                    failed++;
+                }
+                running--;
+                finished = TRUE;
+            }
+        }
+        if (finished || running == 0) {
+            continue;
+        }
+
+        int nfds = 0;
+        fds[nfds].fd = JobEventFd();
+        fds[nfds++].events = POLLIN;
+        for (i = 0; i < max_jobs; i++) {
+            if (slots[i].job != NULL && slots[i].out != -1) {
+                fds[nfds].fd = slots[i].out;
+                fds[nfds++].events = POLLIN;
+            }
+        }
+
+        if (poll(fds, nfds, -1) > 0) {
+            for (i = 0; i < max_jobs; i++) {
+                if (slots[i].job == NULL || slots[i].out == -1) {
+                    continue;
+                }
+                for (int j = 1; j < nfds; j++) {
+                    if (fds[j].fd == slots[i].out && fds[j].revents) {
+                        ReadSlot(&slots[i]);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < max_jobs; i++) {
+        free(slots[i].buf);
+    }
+    free(source->line);
+    free(slots);
+    free(fds);
+    return failed > 100 ? 101 : failed;
+}
+
+/*
+ * Execute a command line starting with the parallel builtin
+ *
+ * Returns the exit status of the coordinator
+ */
+int RunParallel(int parse_result, Command *cmd) {
+    Pgm *pgm = FirstPgm(cmd);
+    char **args = pgm->pgmlist + 1;
+    char *description = DescribeCommandLine(cmd);
+    Source source = {cmd, NULL, NULL, 0};
+    int max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int group = FALSE;
+    int background = FALSE;
+    int input = -1;
+
+    for (; *args && **args == '-'; args++) {
+        if (strcmp(*args, "-g") == 0) {
+            group = TRUE;
+        } else if (strcmp(*args, "-j") == 0 && args[1] != NULL) {
+            max_jobs = atoi(*++args);
+        } else if (strncmp(*args, "-j", 2) == 0 && (*args)[2] != '\0') {
+            max_jobs = atoi(*args + 2);
+        } else {
+            fprintf(stderr, "usage: parallel [-j jobs] [-g] [command ; ...]\n");
+            free(description);
+            return 2;
+        }
+    }
+    if (max_jobs < 1) {
+        max_jobs = 1;
+    }
+    pgm->pgmlist = args;
+
+    for (Command *c = cmd; c != NULL; c = c->next) {
+        background = c->background;
+    }
+
+    if (*args == NULL) {
+        if (pgm != cmd->pgm || cmd->next != NULL) {
+            fprintf(stderr, "parallel: missing command\n");
+            free(description);
+            return 2;
+        }
+        // No commands on the line, read them from standard input
+        if (cmd->rstdin != NULL && (input = open(cmd->rstdin, O_RDONLY)) == -1) {
+            perror(cmd->rstdin);
+            free(description);
+            return 1;
+        }
+        source.next = NULL;
+    }
+
+    Job *job = AddJob(description, background);
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) { // In child
+        JobChildInit(job);
+        EnterSubshell();
+        if (*args == NULL) {
+            if (input != -1) {
+                dup2(input, STDIN_FILENO);
+                close(input);
+            }
+            source.in = stdin;
+        }
+        exit(Coordinate(&source, max_jobs, group));
+    }
+
+    if (input != -1) {
+        close(input);
+    }
+    if (child == -1) {
+        perror("parallel: fork");
+        RemoveJob(job);
+        return 1;
+    }
+    AddJobProcess(job, child, "parallel");
+    return FinishJob(job, background);
+}
@@ -0,0 +1,3 @@
+extern int IsParallel(Command *);
+
+extern int RunParallel(int, Command *);
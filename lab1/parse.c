@@ -14,30 +14,112 @@
 #define BG ('&')
 #define RIN ('<')
 #define RUT ('>')
+#define SEQ (';')
 
 #define ispipe(c) ((c) == PIPE)
 #define isbg(c) ((c) == BG)
 #define isrin(c) ((c) == RIN)
 #define isrut(c) ((c) == RUT)
-#define isspec(c) (ispipe(c) || isbg(c) || isrin(c) || isrut(c))
+#define isseq(c) ((c) == SEQ)
+#define isspec(c) (ispipe(c) || isbg(c) || isrin(c) || isrut(c) || isseq(c))
+#define isfdredirect(s) (isdigit((s)[0]) && (isrin((s)[1]) || isrut((s)[1])))
 
+#define MAXCOMMANDS 20
+#define MAXREDIRECTS 20
+
+static Command linebuf[MAXCOMMANDS], *lp;
+static Redirect redirbuf[MAXREDIRECTS], *rp;
 static Pgm cmdbuf[20], *cmds;
 static char cbuf[256], *cp;
 static char *pbuf[50], **pp;
 
+static void initcommand(Command *c, int connector) {
+    c->rstdin = NULL;
+    c->rstdout = NULL;
+    c->rstderr = NULL;
+    c->redirects = NULL;
+    c->background = FALSE;
+    c->pgm = NULL;
+    c->connector = connector;
+    c->next = NULL;
+}
+
+/*
+ * Parse the target of the redirection operator op ("<", "2>>", "2>&" ...)
+ * from t and append the redirection to c. Returns the number of
+ * characters used from t, or -1 on error.
+ */
+static int redirect(char *t, char *op, Command *c) {
+    static char *names[] = {"stdin", "stdout", "stderr"};
+    Redirect *r, **last;
+    char *target;
+    int n;
+
+    if (rp == redirbuf + MAXREDIRECTS) {
+        fprintf(stderr, "too many redirections\n");
+        return -1;
+    }
+    r = rp++;
+    r->fd = isdigit(*op) ? *op++ - '0' : (isrin(*op) ? 0 : 1);
+    r->file = NULL;
+    r->dupfd = -1;
+    r->next = NULL;
+
+    if ((n = nexttoken(t, &target)) <= 0 || isspec(*target) || isfdredirect(target)) {
+        fprintf(stderr, "missing target for redirection\n");
+        return -1;
+    }
+
+    if (isrin(op[1])) { /* n<<< word */
+        r->type = REDIR_STRING;
+        r->file = target;
+    } else if (isbg(op[1])) { /* n>&m, n<&m and n>&- */
+        if (strcmp(target, "-") == 0) {
+            r->type = REDIR_CLOSE;
+        } else if (isdigit(target[0]) && target[1] == '\0') {
+            r->type = REDIR_DUP;
+            r->dupfd = target[0] - '0';
+        } else {
+            fprintf(stderr, "Illegal file descriptor: \"%s\"\n", target);
+            return -1;
+        }
+    } else {
+        if (isrut(op[1]) && op[2] != '\0') {
+            fprintf(stderr, "Illegal redirection: \"%s\"\n", op);
+            return -1;
+        }
+        if (!isidentifier(target) && strstr(target, "$(") == NULL) { /* Names from $(...) are taken as is */
+            fprintf(stderr, "Illegal filename: \"%s\"\n", target);
+            return -1;
+        }
+        r->type = isrin(*op) ? REDIR_IN : (isrut(op[1]) ? REDIR_APPEND : REDIR_OUT);
+        r->file = target;
+
+        if (r->fd <= 2) {
+            char **file = r->fd == 0 ? &c->rstdin : (r->fd == 1 ? &c->rstdout : &c->rstderr);
+            if (*file != NULL) {
+                fprintf(stderr, "duplicate redirection of %s\n", names[r->fd]);
+                return -1;
+            }
+            *file = target;
+        }
+    }
+
+    for (last = &c->redirects; *last != NULL; last = &(*last)->next);
+    *last = r;
+    return n;
+}
+
 int parse(char *buf, Command *c) {
     int n;
+    int connector;
     Pgm *cmd0;
 
     char *t = buf;
     char *tok;
 
     init();
-    c->rstdin = NULL;
-    c->rstdout = NULL;
-    c->rstderr = NULL;
-    c->background = FALSE;
-    c->pgm = NULL;
+    initcommand(c, CONNECT_NONE);
 
     newcmd:
     if ((n = acmd(t, &cmd0)) <= 0) {
@@ -56,45 +138,40 @@ int parse(char *buf, Command *c) {
     }
     t += n;
 
+    if (isfdredirect(tok)) {
+        if ((n = redirect(t, tok, c)) < 0) {
+            return -1;
+        }
+        t += n;
+        goto newtoken;
+    }
+
     switch (*tok) {
         case PIPE:
+            if (tok[1] == PIPE) {
+                connector = CONNECT_OR;
+                goto newline;
+            }
             goto newcmd;
             break;
         case BG:
+            if (tok[1] == BG) {
+                connector = CONNECT_AND;
+                goto newline;
+            }
+            c->background = 1;
+            /* FALLTHROUGH */
+        case SEQ:
             n = nexttoken(t, &tok);
             if (n == 0) {
-                c->background = 1;
                 return 1;
-            } else {
-                fprintf(stderr, "illegal bakgrounding\n");
-                return -1;
             }
+            connector = CONNECT_SEQ;
+            goto newline;
             break;
         case RIN:
-            if (c->rstdin != NULL) {
-                fprintf(stderr, "duplicate redirection of stdin\n");
-                return -1;
-            }
-            if ((n = nexttoken(t, &(c->rstdin))) < 0) {
-                return -1;
-            }
-            if (!isidentifier(c->rstdin)) {
-                fprintf(stderr, "Illegal filename: \"%s\"\n", c->rstdin);
-                return -1;
-            }
-            t += n;
-            goto newtoken;
-            break;
         case RUT:
-            if (c->rstdout != NULL) {
-                fprintf(stderr, "duplicate redirection of stdout\n");
-                return -1;
-            }
-            if ((n = nexttoken(t, &(c->rstdout))) < 0) {
-                return -1;
-            }
-            if (!isidentifier(c->rstdout)) {
-                fprintf(stderr, "Illegal filename: \"%s\"\n", c->rstdout);
+            if ((n = redirect(t, tok, c)) < 0) {
                 return -1;
             }
             t += n;
@@ -104,6 +181,16 @@ int parse(char *buf, Command *c) {
             return -1;
     }
     goto newcmd;
+
+    newline:
+    if (lp == linebuf + MAXCOMMANDS) {
+        fprintf(stderr, "too many commands\n");
+        return -1;
+    }
+    c->next = lp++;
+    c = c->next;
+    initcommand(c, connector);
+    goto newcmd;
 }
 
 void init(void) {
@@ -113,6 +200,8 @@ void init(void) {
     }
     cmdbuf[19].next = NULL;
     cmds = cmdbuf;
+    lp = linebuf;
+    rp = redirbuf;
     cp = cbuf;
     pp = pbuf;
 }
@@ -126,16 +215,40 @@ int nexttoken(char *s, char **tok) {
     if (c == '\0') {
         return 0;
     }
-    if (isspec(c)) {
+    if (isspec(c) || (isdigit(c) && (isrin(*s) || isrut(*s)))) {
+        if (isdigit(c)) { /* File descriptor of a redirection, 2> */
+            *cp++ = c;
+            c = *s++;
+        }
         *cp++ = c;
+        if ((isbg(c) || ispipe(c) || isrut(c)) && *s == c) { /* &&, || and >> */
+            *cp++ = *s++;
+        } else if (isrin(c) && isrin(s[0]) && isrin(s[1])) { /* <<< */
+            *cp++ = *s++;
+            *cp++ = *s++;
+        }
+        if ((isrin(c) || isrut(c)) && isbg(*s)) { /* >& and <& */
+            *cp++ = *s++;
+        }
         *cp++ = '\0';
     } else {
-        *cp++ = c;
-        do {
-            c = *cp++ = *s++;
-        } while (!isspace(c) && !isspec(c) && (c != '\0'));
         --s;
-        --cp;
+        while (!isspace(c = *s) && !isspec(c) && (c != '\0')) {
+            if (c == '$' && s[1] == '(') { /* $(...) is kept whole, up to the matching ) */
+                int depth = 0;
+                *cp++ = *s++;
+                do {
+                    if (*s == '(') {
+                        depth++;
+                    } else if (*s == ')') {
+                        depth--;
+                    }
+                    *cp++ = *s++;
+                } while (depth > 0 && *s != '\0');
+            } else {
+                *cp++ = *s++;
+            }
+        }
         *cp++ = '\0';
     }
     return s - s0;
@@ -151,7 +264,7 @@ int acmd(char *s, Pgm **cmd) {
 
     next:
     n = nexttoken(s, &tok);
-    if (n == 0 || isspec(*tok)) {
+    if (n == 0 || isspec(*tok) || isfdredirect(tok)) {
         *cmd = cmd0;
         *pp++ = NULL;
         return cnt;
@@ -3,12 +3,35 @@ typedef struct c {
     struct c *next;
 } Pgm;
 
+#define REDIR_IN 0     /* n< file */
+#define REDIR_OUT 1    /* n> file */
+#define REDIR_APPEND 2 /* n>> file */
+#define REDIR_DUP 3    /* n>&m or n<&m */
+#define REDIR_CLOSE 4  /* n>&- */
+#define REDIR_STRING 5 /* n<<< word, file is the word */
+
+typedef struct redirect {
+    int fd;
+    int type;
+    char *file;
+    int dupfd;
+    struct redirect *next;
+} Redirect;
+
+#define CONNECT_NONE 0 /* First command on the line */
+#define CONNECT_SEQ 1  /* ; or & */
+#define CONNECT_AND 2  /* && */
+#define CONNECT_OR 3   /* || */
+
 typedef struct node {
     Pgm *pgm;
     char *rstdin;
     char *rstdout;
     char *rstderr;
+    Redirect *redirects; /* All redirections, in the order they were given */
     int background;
+    int connector; /* How this command is joined to the previous one */
+    struct node *next;
 } Command;
 
 extern void init(void);
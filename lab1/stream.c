@@ -0,0 +1,413 @@
+/* Streaming builtins: cat and tee.
+ *
+ * These run in a forked copy of the shell instead of exec'ing an external
+ * program, and move the data with the kernel's zero-copy primitives where
+ * the file types allow it:
+ *
+ *   file -> file          copy_file_range
+ *   pipe <-> anything     splice (tee to duplicate pipe contents)
+ *   file -> anything      sendfile
+ *
+ * and fall back to plain read/write for everything else (e.g. a terminal).
+ * Options other than "-" (cat) and "-a" (tee) are left to the external
+ * programs.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "stream.h"
+
+#define TRUE 1
+#define FALSE 0
+
+#define CHUNK (1 << 30)            /* Bytes asked for per zero-copy call */
+#define BUFSIZE (64 * 1024)        /* Buffer for the read/write fallback */
+#define STREAM_PIPE_SIZE (1 << 20) /* Pipe size asked for, fewer syscalls per MB */
+
+/* Result of the copy strategies */
+#define COPY_DONE 0
+#define COPY_ERROR (-1)
+#define COPY_UNSUPPORTED 1
+
+/*
+ * Errors meaning a zero-copy call does not work for this pair of files
+ */
+static int Unsupported(int error) {
+    return error == EINVAL || error == ENOSYS || error == EXDEV || error == EOPNOTSUPP || error == EBADF;
+}
+
+static int CopyFileRange(int in, int out) {
+    ssize_t n;
+    while ((n = copy_file_range(in, NULL, out, NULL, CHUNK, 0)) > 0);
+    if (n == 0) {
+        return COPY_DONE;
+    }
+    return Unsupported(errno) ? COPY_UNSUPPORTED : COPY_ERROR;
+}
+
+static int Splice(int in, int out) {
+    ssize_t n;
+    while ((n = splice(in, NULL, out, NULL, CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0);
+    if (n == 0) {
+        return COPY_DONE;
+    }
+    return Unsupported(errno) ? COPY_UNSUPPORTED : COPY_ERROR;
+}
+
+static int SendFile(int in, int out) {
+    ssize_t n;
+    while ((n = sendfile(out, in, NULL, CHUNK)) > 0);
+    if (n == 0) {
+        return COPY_DONE;
+    }
+    return Unsupported(errno) ? COPY_UNSUPPORTED : COPY_ERROR;
+}
+
+/*
+ * Write all of buf, returns FALSE on error
+ */
+static int WriteAll(int fd, char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        buf += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+static int ReadWrite(int in, int out) {
+    char *buf = malloc(BUFSIZE);
+    ssize_t n;
+
+    while ((n = read(in, buf, BUFSIZE)) > 0 || (n < 0 && errno == EINTR)) {
+        if (n > 0 && !WriteAll(out, buf, n)) {
+            n = -1;
+            break;
+        }
+    }
+    free(buf);
+    return n == 0 ? COPY_DONE : COPY_ERROR;
+}
+
+/*
+ * Copy everything from in to out with the cheapest method the file types allow.
+ *
+ * The zero-copy calls all advance the file offsets, so when one turns out
+ * to be unsupported the next method continues where it stopped.
+ */
+static int CopyFd(int in, int out) {
+    struct stat in_stat, out_stat;
+    int result = COPY_UNSUPPORTED;
+
+    if (fstat(in, &in_stat) == -1 || fstat(out, &out_stat) == -1) {
+        return COPY_ERROR;
+    }
+
+    if (S_ISFIFO(out_stat.st_mode)) {
+        fcntl(out, F_SETPIPE_SZ, STREAM_PIPE_SIZE);
+    }
+
+    if (S_ISREG(in_stat.st_mode) && S_ISREG(out_stat.st_mode)) {
+        result = CopyFileRange(in, out);
+    }
+    if (result == COPY_UNSUPPORTED && (S_ISFIFO(in_stat.st_mode) || S_ISFIFO(out_stat.st_mode))) {
+        result = Splice(in, out);
+    }
+    if (result == COPY_UNSUPPORTED && S_ISREG(in_stat.st_mode)) {
+        result = SendFile(in, out);
+    }
+    if (result == COPY_UNSUPPORTED) {
+        result = ReadWrite(in, out);
+    }
+    return result;
+}
+
+/*
+ * The cat builtin, concatenate files (or standard input) to standard output
+ */
+static int Cat(char **args) {
+    int status = 0;
+    int in;
+
+    if (*args == NULL) {
+        return CopyFd(STDIN_FILENO, STDOUT_FILENO) == COPY_DONE ? 0 : 1;
+    }
+
+    for (; *args; args++) {
+        if (strcmp(*args, "-") == 0) {
+            in = STDIN_FILENO;
+        } else if ((in = open(*args, O_RDONLY)) == -1) {
+            fprintf(stderr, "cat: %s: %s\n", *args, strerror(errno));
+            status = 1;
+            continue;
+        }
+
+        if (CopyFd(in, STDOUT_FILENO) != COPY_DONE) {
+            fprintf(stderr, "cat: %s: %s\n", *args, strerror(errno));
+            status = 1;
+        }
+        if (in != STDIN_FILENO) {
+            close(in);
+        }
+    }
+    return status;
+}
+
+/*
+ * Move up to len bytes from the pipe in to out, falling back to read/write
+ * if out does not accept splice. Returns the number of bytes taken from in,
+ * 0 at end of input or -1 on error. Bytes the fallback read but could not
+ * write are lost; then *failed is set and they still count as taken.
+ */
+static ssize_t SpliceSome(int in, int out, size_t len, int *failed) {
+    char buf[BUFSIZE];
+    ssize_t n;
+
+    do {
+        n = splice(in, NULL, out, NULL, len, SPLICE_F_MOVE | SPLICE_F_MORE);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0 && Unsupported(errno)) {
+        n = read(in, buf, len < sizeof(buf) ? len : sizeof(buf));
+        if (n > 0 && !WriteAll(out, buf, n)) {
+            *failed = TRUE;
+        }
+    }
+    return n;
+}
+
+/*
+ * Throw away len bytes from in
+ */
+static void Discard(int in, size_t len) {
+    char buf[BUFSIZE];
+
+    while (len > 0) {
+        ssize_t n = read(in, buf, len < sizeof(buf) ? len : sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        len -= n;
+    }
+}
+
+/*
+ * Move exactly len bytes from the pipe in to out. If out fails, the rest
+ * of the len bytes are taken from in all the same and thrown away.
+ * Returns FALSE if out failed.
+ */
+static int SpliceAll(int in, int out, size_t len) {
+    size_t taken = 0;
+    int failed = FALSE;
+
+    while (taken < len && !failed) {
+        ssize_t n = SpliceSome(in, out, len - taken, &failed);
+        if (n <= 0) {
+            failed = TRUE;
+            break;
+        }
+        taken += n;
+    }
+    if (failed) {
+        Discard(in, len - taken);
+    }
+    return !failed;
+}
+
+/*
+ * Copy standard input to every fd in outs with read/write
+ */
+static int TeeReadWrite(int *outs, int num_outs) {
+    char *buf = malloc(BUFSIZE);
+    int status = 0;
+    ssize_t n;
+
+    while ((n = read(STDIN_FILENO, buf, BUFSIZE)) > 0 || (n < 0 && errno == EINTR)) {
+        for (int i = 0; i < num_outs; i++) {
+            if (outs[i] != -1 && !WriteAll(outs[i], buf, n)) {
+                outs[i] = -1;
+                status = 1;
+            }
+        }
+    }
+    free(buf);
+    return n == 0 ? status : 1;
+}
+
+/*
+ * Copy the pipe on standard input to every fd in outs without copying
+ * through user space.
+ *
+ * For every output but the last, the data at the head of the input pipe
+ * is duplicated with tee into an empty scratch pipe and spliced on from
+ * there. The last output gets the same bytes spliced straight out of the
+ * input pipe, which consumes them. Returns COPY_UNSUPPORTED if standard
+ * input is not a pipe.
+ */
+static int TeeSplice(int *outs, int num_outs) {
+    struct stat in_stat;
+    int scratch[2];
+    int status = 0;
+
+    if (fstat(STDIN_FILENO, &in_stat) == -1 || !S_ISFIFO(in_stat.st_mode) || pipe(scratch) == -1) {
+        return COPY_UNSUPPORTED;
+    }
+
+    // The scratch pipe must be able to hold all of the input pipe at once
+    int size = fcntl(STDIN_FILENO, F_GETPIPE_SZ);
+    if (size == -1 || fcntl(scratch[1], F_SETPIPE_SZ, size) < size) {
+        close(scratch[0]);
+        close(scratch[1]);
+        return COPY_UNSUPPORTED;
+    }
+
+    while (TRUE) {
+        ssize_t n = -1;
+        int copies = FALSE; // Is an output before the last still live?
+        int last = num_outs - 1;
+        while (last >= 0 && outs[last] == -1) {
+            last--;
+        }
+        if (last < 0) { // Every output failed
+            break;
+        }
+
+        for (int i = 0; i < last; i++) {
+            if (outs[i] == -1) {
+                continue;
+            }
+            copies = TRUE;
+            do {
+                n = tee(STDIN_FILENO, scratch[1], n < 0 ? (size_t) size : (size_t) n, 0);
+            } while (n < 0 && errno == EINTR);
+            if (n <= 0) {
+                break;
+            }
+
+            if (!SpliceAll(scratch[0], outs[i], n)) {
+                outs[i] = -1;
+                status = 1;
+            }
+        }
+
+        if (!copies) { // A single output, no copies needed
+            int failed = FALSE;
+            n = SpliceSome(STDIN_FILENO, outs[last], size, &failed);
+            if (n < 0 || failed) {
+                status = 1;
+            }
+            if (n <= 0 || failed) {
+                break;
+            }
+        } else if (n < 0) { // tee failed
+            status = 1;
+            break;
+        } else if (n == 0) { // End of input
+            break;
+        } else if (!SpliceAll(STDIN_FILENO, outs[last], n)) {
+            outs[last] = -1;
+            status = 1;
+        }
+    }
+
+    close(scratch[0]);
+    close(scratch[1]);
+    return status ? COPY_ERROR : COPY_DONE;
+}
+
+static int CountArgs(char **args) {
+    int count = 0;
+    while (args[count] != NULL) {
+        count++;
+    }
+    return count;
+}
+
+/*
+ * The tee builtin, copy standard input to standard output and files
+ */
+static int Tee(char **args) {
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    int status = 0;
+    int num_outs = 0;
+    int result;
+
+    if (*args != NULL && strcmp(*args, "-a") == 0) {
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+        args++;
+    }
+
+    int *outs = malloc((CountArgs(args) + 1) * sizeof(int));
+    outs[num_outs++] = STDOUT_FILENO;
+    for (; *args; args++) {
+        int fd = open(*args, flags, 0664);
+        if (fd == -1) {
+            fprintf(stderr, "tee: %s: %s\n", *args, strerror(errno));
+            status = 1;
+        } else {
+            outs[num_outs++] = fd;
+        }
+    }
+
+    result = TeeSplice(outs, num_outs);
+    if (result == COPY_UNSUPPORTED) {
+        result = TeeReadWrite(outs, num_outs) ? COPY_ERROR : COPY_DONE;
+    }
+
+    for (int i = 1; i < num_outs; i++) {
+        if (outs[i] != -1) {
+            close(outs[i]);
+        }
+    }
+    free(outs);
+    return status || result != COPY_DONE;
+}
+
+/*
+ * Check if command can run as a streaming builtin
+ */
+int IsStreamBuiltin(char **command) {
+    char **arg;
+
+    if (strcmp("cat", command[0]) == 0) {
+        for (arg = command + 1; *arg; arg++) {
+            if (**arg == '-' && strcmp(*arg, "-") != 0) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    } else if (strcmp("tee", command[0]) == 0) {
+        for (arg = command + 1; *arg; arg++) {
+            if (**arg == '-' && !(arg == command + 1 && strcmp(*arg, "-a") == 0)) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Run a streaming builtin with the stage's standard input and output
+ * already in place. Returns its exit status.
+ */
+int RunStreamBuiltin(char **command) {
+    if (strcmp("cat", command[0]) == 0) {
+        return Cat(command + 1);
+    }
+    return Tee(command + 1);
+}
@@ -0,0 +1,3 @@
+extern int IsStreamBuiltin(char **);
+
+extern int RunStreamBuiltin(char **);
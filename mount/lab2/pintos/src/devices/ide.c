@@ -87,6 +87,7 @@ static void identify_ata_device (struct ata_disk *);
 
 static void select_sector (struct ata_disk *, block_sector_t);
 static void issue_pio_command (struct channel *, uint8_t command);
+static bool wait_for_completion (struct channel *);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
@@ -349,7 +350,8 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
   lock_acquire (&c->lock);
   select_sector (d, sec_no);
   issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
+  if (!wait_for_completion (c))
+    PANIC ("%s: disk read timed out, sector=%"PRDSNu, d->name, sec_no);
   if (!wait_while_busy (d))
     PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
   input_sector (c, buffer);
@@ -372,7 +374,8 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   if (!wait_while_busy (d))
     PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
   output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  if (!wait_for_completion (c))
+    PANIC ("%s: disk write timed out, sector=%"PRDSNu, d->name, sec_no);
   lock_release (&c->lock);
 }
 
@@ -414,6 +417,16 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
+/* Waits up to 30 seconds for channel C's completion interrupt,
+   as long as wait_while_busy() allows a disk to stay busy.
+   Returns false if it never came. */
+static bool
+wait_for_completion (struct channel *c)
+{
+  return sema_down_timeout (&c->completion_wait,
+                            timer_ticks () + 30 * TIMER_FREQ);
+}
+
 /* Reads a sector from channel C's data register in PIO mode into
    SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
 static void
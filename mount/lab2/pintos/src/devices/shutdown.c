@@ -5,7 +5,11 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/ktask.h"
+#include "threads/palloc.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
@@ -13,6 +17,11 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/pcache.h"
+#include "vm/stats.h"
+#include "vm/zswap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -120,6 +129,10 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  workqueue_print_stats ();
+  softirq_print_stats ();
+  ktask_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -128,4 +141,9 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  vm_stats_print ();
+  zswap_print_stats ();
+  pcache_print_stats ();
+#endif
 }
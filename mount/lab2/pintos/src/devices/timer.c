@@ -5,9 +5,9 @@
 #include <stdio.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
-#include <threads/malloc.h>
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -26,17 +26,15 @@ static int64_t ticks;
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static softirq_func timer_softirq;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
-struct list *blocked_threads;
-
-struct blocked_thread {
-    struct list_elem elem;
-    struct thread *thread;
-};
+/* Pending timeouts, soonest first.  Interrupts must be off to
+   touch this list. */
+static struct list timeouts;
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -45,7 +43,8 @@ timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-  list_init (&blocked_threads);
+  softirq_register (SOFTIRQ_TIMER, timer_softirq, "timer");
+  list_init (&timeouts);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -75,13 +74,21 @@ timer_calibrate (void)
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
-/* Returns the number of timer ticks since the OS booted. */
+/* Returns the number of timer ticks since the OS booted.  The
+   64-bit count is read in two halves, so it is read until two
+   reads agree, instead of with interrupts off: a tick that lands
+   between the halves changes it. */
 int64_t
 timer_ticks (void) 
 {
-  enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
-  intr_set_level (old_level);
+  int64_t t;
+
+  do 
+    {
+      t = ticks;
+      barrier ();
+    }
+  while (t != ticks);
   return t;
 }
 
@@ -94,30 +101,84 @@ timer_elapsed (int64_t then)
 }
 
 
-/* Sleeps for approximately TICKS timer sleep_ticks.  Interrupts must
-   be turned on. */
+/* Returns true if timeout A is due before timeout B. */
+static bool
+timeout_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct timer_timeout *a = list_entry (a_, struct timer_timeout, elem);
+  const struct timer_timeout *b = list_entry (b_, struct timer_timeout, elem);
+  return a->deadline < b->deadline;
+}
+
+/* Arranges for FUNC (AUX) to be called at the first tick at or
+   after DEADLINE, a value on the timer_ticks() scale, unless
+   timer_timeout_cancel() cancels TIMEOUT first.  FUNC runs from
+   the timer softirq with interrupts off, not from the timer
+   interrupt itself, and must not sleep.  A DEADLINE already
+   passed fires at the next tick.  TIMEOUT must stay alive until
+   it fires or is cancelled. */
 void
-timer_sleep (int64_t sleep_ticks)
+timer_timeout_add (struct timer_timeout *timeout, int64_t deadline,
+                   timer_timeout_func *func, void *aux)
 {
-  // Don't do anything if alarm isn't in future
-  if (sleep_ticks <= 0)
-  {
-      return;
-  }
+  enum intr_level old_level;
 
-  // Create a new alarm
-  thread_current ()->alarm_tick = timer_ticks () + sleep_ticks;
+  ASSERT (timeout != NULL);
+  ASSERT (func != NULL);
 
-  struct blocked_thread* new_thread = malloc (sizeof (struct blocked_thread));
-  new_thread->thread = thread_current();
-  list_push_front (&blocked_threads, new_thread);
+  timeout->deadline = deadline;
+  timeout->func = func;
+  timeout->aux = aux;
+  old_level = intr_disable ();
+  timeout->pending = true;
+  list_insert_ordered (&timeouts, &timeout->elem, timeout_less, NULL);
+  intr_set_level (old_level);
+}
 
-  // Block the thread
-  enum intr_level old_level = intr_set_level (INTR_OFF);
-  thread_block ();
-  intr_set_level (INTR_ON);
+/* Cancels TIMEOUT.  Returns true if it was still pending, false
+   if it already fired or was cancelled before. */
+bool
+timer_timeout_cancel (struct timer_timeout *timeout)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  old_level = intr_disable ();
+  was_pending = timeout->pending;
+  if (was_pending)
+    {
+      list_remove (&timeout->elem);
+      timeout->pending = false;
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Timeout function that wakes the thread it was given. */
+static void
+wake_sleeper (void *t)
+{
+  thread_unblock (t);
+}
+
+/* Sleeps for approximately SLEEP_TICKS timer ticks.  Interrupts
+   must be turned on. */
+void
+timer_sleep (int64_t sleep_ticks)
+{
+  struct timer_timeout timeout;
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  if (sleep_ticks <= 0)
+    return;
 
-  free (new_thread);
+  old_level = intr_disable ();
+  timer_timeout_add (&timeout, ticks + sleep_ticks, wake_sleeper,
+                     thread_current ());
+  thread_block ();
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -190,44 +251,47 @@ timer_print_stats (void)
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
-int
-check_alarm (struct thread* t)
-{
-  if (t->status == THREAD_BLOCKED)
-  {
-    if (t->alarm_tick >= 0 && ticks >= t->alarm_tick)
-    {
-      thread_unblock (t);
-      t->alarm_tick = -1;
-      return 1;
-    }
-  }
-  return 0;
-}
-
-/* Timer interrupt handler. */
+/* Timer interrupt handler.  Fires the timeouts that are due,
+   which are at the front of the list. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
   ticks++;
 
-  struct list_elem *e;
-  for (e = list_begin (&blocked_threads);
-       e != list_end (&blocked_threads);)
-  {
-    struct blocked_thread *element = list_entry (e, struct blocked_thread, elem);
-    int unblocked = check_alarm (element->thread);
-
-    struct list_elem *next = list_next (e);
-    if (unblocked) {
-      list_remove (e);
-    }
-    e = next;
-  }
+  /* Leave firing expired timeouts to the softirq. */
+  if (!list_empty (&timeouts)
+      && list_entry (list_front (&timeouts), struct timer_timeout,
+                     elem)->deadline <= ticks)
+    softirq_raise (SOFTIRQ_TIMER);
 
   thread_tick ();
 }
 
+/* Fires expired timeouts.  Each one is removed and its function
+   called with interrupts off, so that it cannot race with
+   timer_timeout_cancel(), but interrupts are let in between. */
+static void
+timer_softirq (void)
+{
+  for (;;)
+    {
+      struct timer_timeout *timeout;
+
+      intr_disable ();
+      if (list_empty (&timeouts))
+        break;
+      timeout = list_entry (list_front (&timeouts),
+                            struct timer_timeout, elem);
+      if (timeout->deadline > ticks)
+        break;
+      list_pop_front (&timeouts);
+      timeout->pending = false;
+      timeout->func (timeout->aux);
+      intr_enable ();
+    }
+  intr_enable ();
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
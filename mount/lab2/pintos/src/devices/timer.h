@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -19,6 +21,25 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* A function called when a timeout expires, with interrupts off,
+   from the timer's softirq.  It must not sleep. */
+typedef void timer_timeout_func (void *aux);
+
+/* A timeout.  Owned by the caller, who initializes it with
+   timer_timeout_add(). */
+struct timer_timeout
+  {
+    struct list_elem elem;      /* Element in the timeout list. */
+    int64_t deadline;           /* Tick at which to fire. */
+    timer_timeout_func *func;   /* Called when it fires. */
+    void *aux;                  /* Passed to FUNC. */
+    bool pending;               /* Neither fired nor cancelled yet? */
+  };
+
+void timer_timeout_add (struct timer_timeout *, int64_t deadline,
+                        timer_timeout_func *, void *aux);
+bool timer_timeout_cancel (struct timer_timeout *);
+
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
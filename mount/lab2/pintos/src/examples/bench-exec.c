@@ -0,0 +1,39 @@
+/* bench-exec.c
+
+   Measures the exec()/wait() round trip: starting a process that
+   exits at once and waiting for it.  The child is this program,
+   run with "-c".
+
+   usage: bench-exec [ROUND-TRIPS] */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+int
+main (int argc, char *argv[]) 
+{
+  int round_trips;
+  struct bench_clock clock;
+  int i;
+
+  if (argc > 1 && !strcmp (argv[1], "-c"))
+    return 42;
+
+  round_trips = bench_arg (argc, argv, 1, 50);
+  bench_init ("bench-exec");
+
+  bench_start (&clock);
+  for (i = 0; i < round_trips; i++) 
+    {
+      pid_t pid = exec ("bench-exec -c");
+      if (pid == PID_ERROR || wait (pid) != 42) 
+        {
+          printf ("bench-exec: exec or wait failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  bench_stop (&clock, "exec-wait", round_trips);
+  return EXIT_SUCCESS;
+}
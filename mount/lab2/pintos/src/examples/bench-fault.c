@@ -0,0 +1,64 @@
+/* bench-fault.c
+
+   Measures page fault throughput: touches every page of a large
+   zero-filled array once, which faults each page in, and then
+   once more, which should not fault at all.  Writes are
+   measured on one half of the array and reads on the other.
+
+   usage: bench-fault [PAGES]  (at most 1024) */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define PAGE_SIZE 4096
+#define MAX_PAGES 1024
+
+static char array[MAX_PAGES][PAGE_SIZE];
+
+/* Writes one byte to each of PAGES pages starting at FIRST. */
+static void
+touch_write (int first, int pages, const char *key) 
+{
+  struct bench_clock clock;
+  int i;
+
+  bench_start (&clock);
+  for (i = first; i < first + pages; i++)
+    array[i][0] = i;
+  bench_stop (&clock, key, pages);
+}
+
+/* Reads one byte from each of PAGES pages starting at FIRST. */
+static void
+touch_read (int first, int pages, const char *key) 
+{
+  struct bench_clock clock;
+  int i;
+
+  bench_start (&clock);
+  for (i = first; i < first + pages; i++)
+    (void) *(volatile char *) array[i];
+  bench_stop (&clock, key, pages);
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  int pages = bench_arg (argc, argv, 1, MAX_PAGES);
+  int half;
+
+  if (pages < 2 || pages > MAX_PAGES) 
+    {
+      printf ("usage: bench-fault [PAGES]  (2 to %d)\n", MAX_PAGES);
+      return EXIT_FAILURE;
+    }
+  half = pages / 2;
+
+  bench_init ("bench-fault");
+  touch_write (0, half, "write-fault");
+  touch_write (0, half, "write-resident");
+  touch_read (half, pages - half, "read-fault");
+  touch_read (half, pages - half, "read-resident");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/* bench-file.c
+
+   Measures file throughput through the read() and write() system
+   calls, sequentially and at random block-aligned offsets, for
+   several block sizes.
+
+   usage: bench-file [FILE-KB] */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define MAX_BLOCK 16384
+#define RANDOM_OPS 64
+
+static char buffer[MAX_BLOCK];
+
+/* Reads or writes FILE_SIZE bytes of FD, BLOCK_SIZE bytes at a
+   time, through the whole file in order if SEQUENTIAL, otherwise
+   at random offsets. */
+static bool
+measure (int fd, int file_size, int block_size, bool write_, bool sequential) 
+{
+  struct bench_clock clock;
+  int block_cnt = file_size / block_size;
+  int ops = sequential ? block_cnt : RANDOM_OPS;
+  char key[32];
+  int i;
+
+  bench_start (&clock);
+  if (sequential)
+    seek (fd, 0);
+  for (i = 0; i < ops; i++) 
+    {
+      int done;
+
+      if (!sequential)
+        seek (fd, random_ulong () % block_cnt * block_size);
+      done = (write_
+              ? write (fd, buffer, block_size)
+              : read (fd, buffer, block_size));
+      if (done != block_size) 
+        {
+          printf ("bench-file: %s of %d bytes failed\n",
+                  write_ ? "write" : "read", block_size);
+          return false;
+        }
+    }
+  snprintf (key, sizeof key, "%s-%s-%d", sequential ? "seq" : "random",
+            write_ ? "write" : "read", block_size);
+  bench_stop_bytes (&clock, key, ops, (long long) ops * block_size);
+  return true;
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  static const int block_sizes[] = {512, 4096, MAX_BLOCK};
+  int file_size = bench_arg (argc, argv, 1, 64) * 1024;
+  bool ok = true;
+  size_t i;
+  int fd;
+
+  if (file_size < MAX_BLOCK) 
+    {
+      printf ("usage: bench-file [FILE-KB]  (at least %d)\n",
+              MAX_BLOCK / 1024);
+      return EXIT_FAILURE;
+    }
+
+  bench_init ("bench-file");
+  random_init (0);
+  memset (buffer, 0x5a, sizeof buffer);
+  if (!create ("bench.dat", file_size) || (fd = open ("bench.dat")) < 0) 
+    {
+      printf ("bench.dat: create failed\n");
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; ok && i < sizeof block_sizes / sizeof *block_sizes; i++)
+    ok = (measure (fd, file_size, block_sizes[i], true, true)
+          && measure (fd, file_size, block_sizes[i], false, true)
+          && measure (fd, file_size, block_sizes[i], true, false)
+          && measure (fd, file_size, block_sizes[i], false, false));
+
+  close (fd);
+  remove ("bench.dat");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,52 @@
+/* bench-futex.c
+
+   Measures the two paths of a futex-based mutex: lock/unlock
+   pairs on an uncontended mutex, which stay in user space, and
+   the system calls taken on contention, futex_wake() with no
+   sleepers and futex_wait() on a word that has already changed,
+   which both return at once.
+
+   usage: bench-futex [PAIRS] */
+
+#include <mutex.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+int
+main (int argc, char *argv[])
+{
+  int pairs = bench_arg (argc, argv, 1, 100000);
+  int calls = pairs / 10;
+  struct bench_clock clock;
+  struct mutex m;
+  int word = 0;
+  int i;
+
+  bench_init ("bench-futex");
+
+  mutex_init (&m);
+  bench_start (&clock);
+  for (i = 0; i < pairs; i++)
+    {
+      mutex_lock (&m);
+      mutex_unlock (&m);
+    }
+  bench_stop (&clock, "uncontended", pairs);
+
+  bench_start (&clock);
+  for (i = 0; i < calls; i++)
+    futex_wake (&word, 1);
+  bench_stop (&clock, "wake", calls);
+
+  bench_start (&clock);
+  for (i = 0; i < calls; i++)
+    if (futex_wait (&word, 1) != -1)
+      {
+        printf ("futex_wait slept on a changed word\n");
+        return EXIT_FAILURE;
+      }
+  bench_stop (&clock, "wait-changed", calls);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+/* bench-syscall.c
+
+   Measures the round trip into the kernel and back with the
+   cheapest system call there is, tell() on an open file, which
+   only looks up the file descriptor.
+
+   usage: bench-syscall [CALLS] */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+int
+main (int argc, char *argv[]) 
+{
+  int calls = bench_arg (argc, argv, 1, 10000);
+  struct bench_clock clock;
+  int fd, i;
+
+  bench_init ("bench-syscall");
+  if (!create ("bench.tmp", 0) || (fd = open ("bench.tmp")) < 0) 
+    {
+      printf ("bench.tmp: create failed\n");
+      return EXIT_FAILURE;
+    }
+
+  bench_start (&clock);
+  for (i = 0; i < calls; i++)
+    tell (fd);
+  bench_stop (&clock, "null-call", calls);
+
+  close (fd);
+  remove ("bench.tmp");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/* bench-uthread.c
+
+   Measures the uthread_create()/uthread_join() round trip, the
+   user thread counterpart of bench-exec, and then THREADS
+   threads incrementing a shared counter under a futex mutex,
+   which exercises its contended path.
+
+   usage: bench-uthread [ROUND-TRIPS] [THREADS] */
+
+#include <mutex.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define MAX_THREADS 16
+#define INCREMENTS 10000        /* Per thread. */
+
+static struct mutex counter_lock = MUTEX_INITIALIZER;
+static int counter;
+
+static int
+exit_at_once (void *aux)
+{
+  return (int) aux;
+}
+
+static int
+increment (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < INCREMENTS; i++)
+    {
+      mutex_lock (&counter_lock);
+      counter++;
+      mutex_unlock (&counter_lock);
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int round_trips = bench_arg (argc, argv, 1, 200);
+  int threads = bench_arg (argc, argv, 2, 4);
+  uthread_t tids[MAX_THREADS];
+  struct bench_clock clock;
+  int i;
+
+  if (threads < 1 || threads > MAX_THREADS)
+    {
+      printf ("usage: bench-uthread [ROUND-TRIPS] [THREADS]"
+              "  (THREADS 1 to %d)\n", MAX_THREADS);
+      return EXIT_FAILURE;
+    }
+  bench_init ("bench-uthread");
+
+  bench_start (&clock);
+  for (i = 0; i < round_trips; i++)
+    {
+      uthread_t tid = uthread_create (exit_at_once, (void *) 42);
+      if (tid == UTHREAD_ERROR || uthread_join (tid) != 42)
+        {
+          printf ("uthread_create/uthread_join failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  bench_stop (&clock, "create-join", round_trips);
+
+  bench_start (&clock);
+  for (i = 0; i < threads; i++)
+    {
+      tids[i] = uthread_create (increment, NULL);
+      if (tids[i] == UTHREAD_ERROR)
+        {
+          printf ("uthread_create failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < threads; i++)
+    uthread_join (tids[i]);
+  bench_stop (&clock, "locked-increment", (long) threads * INCREMENTS);
+
+  if (counter != threads * INCREMENTS)
+    {
+      printf ("counter is %d, expected %d\n", counter, threads * INCREMENTS);
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,55 @@
+/* bench.c
+
+   Result reporting shared by the bench-* programs. */
+
+#include "bench.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *bench_name;
+
+/* Sets the program name printed with every result. */
+void
+bench_init (const char *name) 
+{
+  bench_name = name;
+}
+
+/* Returns ARGV[IDX] as an integer, or DEF if there are not that
+   many arguments. */
+int
+bench_arg (int argc, char *argv[], int idx, int def) 
+{
+  return idx < argc ? atoi (argv[idx]) : def;
+}
+
+/* Starts measuring into CLOCK. */
+void
+bench_start (struct bench_clock *clock) 
+{
+  clock->cycles = bench_cycles ();
+}
+
+/* Stops measuring CLOCK and prints the result line for OPS
+   operations of kind KEY. */
+void
+bench_stop (struct bench_clock *clock, const char *key, long ops) 
+{
+  uint64_t cycles = bench_cycles () - clock->cycles;
+
+  printf ("(%s) result %s ops %ld cycles %"PRIu64"\n",
+          bench_name, key, ops, cycles);
+}
+
+/* Like bench_stop(), for OPS operations that moved BYTES bytes
+   in total. */
+void
+bench_stop_bytes (struct bench_clock *clock, const char *key, long ops,
+                  long long bytes) 
+{
+  uint64_t cycles = bench_cycles () - clock->cycles;
+
+  printf ("(%s) result %s ops %ld cycles %"PRIu64" bytes %lld\n",
+          bench_name, key, ops, cycles, bytes);
+}
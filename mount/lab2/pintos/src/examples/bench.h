@@ -0,0 +1,39 @@
+#ifndef EXAMPLES_BENCH_H
+#define EXAMPLES_BENCH_H
+
+/* Result reporting for the user-level benchmarks.
+
+   Every result is printed as one line of the form
+
+     (PROGRAM) result KEY ops N cycles C
+
+   followed by " bytes B" for throughput results.  This is the
+   shape of the kernel benchmark results in tests/perf, without
+   the tick count, which user programs cannot read.  Cycles come
+   from the time stamp counter, which user code may read. */
+
+#include <stdint.h>
+
+/* A measurement in progress. */
+struct bench_clock
+  {
+    uint64_t cycles;            /* Time stamp counter at start. */
+  };
+
+void bench_init (const char *name);
+int bench_arg (int argc, char *argv[], int idx, int def);
+void bench_start (struct bench_clock *);
+void bench_stop (struct bench_clock *, const char *key, long ops);
+void bench_stop_bytes (struct bench_clock *, const char *key, long ops,
+                       long long bytes);
+
+/* Reads the processor's time stamp counter. */
+static inline uint64_t
+bench_cycles (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* examples/bench.h */
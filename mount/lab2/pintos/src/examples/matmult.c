@@ -1,57 +1,233 @@
-/* matmult.c 
+/* matmult.c
 
    Test program to do matrix multiplication on large arrays.
- 
+
    Intended to stress virtual memory system.
-   
-   Ideally, we could read the matrices off of the file system,
-   and store the result back to the file system!
+
+   usage: matmult [-k naive|tiled] [-t TILE] [-m FILE] [DIM]
+
+   -k picks the multiplication kernel.  The naive i-j-k loops walk
+   B a column at a time, touching a different page on every step
+   once a row of B is a page or more, so every policy thrashes
+   alike.  The tiled kernel works on TILE by TILE blocks (default
+   32), whose pages stay resident while they are used, so the
+   eviction policy decides how often they have to come back.
+
+   -m maps A and B from FILE with mmap instead of keeping them in
+   BSS, so that evicting them writes back to the file instead of
+   swap.  FILE is created and filled first if it does not exist.
+   Only kernels built with VM support mmap.
+
+   The matrices live in BSS up to DIM 128, small enough for a
+   kernel without VM to load, and on the stack beyond that, which
+   only VM kernels grow on demand.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <syscall.h>
+#include "bench.h"
 
-/* You should define DIM to be large enough that the arrays
-   don't fit in physical memory.
-
-    Dim       Memory
- ------     --------
-     16         3 kB
-     64        48 kB
-    128       192 kB
-    256       768 kB
-    512     3,072 kB
-  1,024    12,288 kB
-  2,048    49,152 kB
-  4,096   196,608 kB
-  8,192   786,432 kB
- 16,384 3,145,728 kB */
-#define DIM 128
-
-int A[DIM][DIM];
-int B[DIM][DIM];
-int C[DIM][DIM];
+/* Pass a DIM large enough that the arrays don't fit in physical
+   memory.  The three arrays take:
 
-int
-main (void)
+    Dim       Memory     Where
+ ------     --------     -----
+     16         3 kB     BSS
+     64        48 kB     BSS
+    128       192 kB     BSS
+    256       768 kB     stack (VM only)
+    512     3,072 kB     stack (VM only) */
+#define DEFAULT_DIM 128
+#define STATIC_DIM 128
+#define MAX_DIM 512
+#define DEFAULT_TILE 32
+#define PAGE_SIZE 4096
+
+int A[STATIC_DIM * STATIC_DIM];
+int B[STATIC_DIM * STATIC_DIM];
+int C[STATIC_DIM * STATIC_DIM];
+
+/* Where -m maps A and B. */
+#define MAP_ADDR ((void *) 0x10000000)
+
+/* Element (I, J) of matrix M, which is DIM by DIM. */
+#define AT(M, I, J) (M)[(I) * dim + (J)]
+
+static int dim;
+
+static void
+init (int *a, int *b, int *c)
+{
+  int i, j;
+
+  for (i = 0; i < dim; i++)
+    for (j = 0; j < dim; j++)
+      {
+	if (a != NULL)
+	  {
+	    AT (a, i, j) = i;
+	    AT (b, i, j) = j;
+	  }
+	AT (c, i, j) = 0;
+      }
+}
+
+static void
+multiply_naive (const int *a, const int *b, int *c)
 {
   int i, j, k;
 
-  /* Initialize the matrices. */
-  for (i = 0; i < DIM; i++)
-    for (j = 0; j < DIM; j++)
+  for (i = 0; i < dim; i++)
+    for (j = 0; j < dim; j++)
+      for (k = 0; k < dim; k++)
+	AT (c, i, j) += AT (a, i, k) * AT (b, k, j);
+}
+
+static void
+multiply_tiled (const int *a, const int *b, int *c, int tile)
+{
+  int i0, j0, k0, i, j, k;
+
+  for (i0 = 0; i0 < dim; i0 += tile)
+    for (k0 = 0; k0 < dim; k0 += tile)
+      for (j0 = 0; j0 < dim; j0 += tile)
+	for (i = i0; i < i0 + tile && i < dim; i++)
+	  for (k = k0; k < k0 + tile && k < dim; k++)
+	    {
+	      int aik = AT (a, i, k);
+	      for (j = j0; j < j0 + tile && j < dim; j++)
+		AT (c, i, j) += aik * AT (b, k, j);
+	    }
+}
+
+/* Creates FILE holding A and B, initialized as by init(). */
+static bool
+create_input (const char *file)
+{
+  int row[MAX_DIM];
+  int fd, m, i, j;
+
+  if (!create (file, 2 * dim * dim * sizeof (int)) || (fd = open (file)) < 0)
+    return false;
+  for (m = 0; m < 2; m++)
+    for (i = 0; i < dim; i++)
       {
-	A[i][j] = i;
-	B[i][j] = j;
-	C[i][j] = 0;
+	for (j = 0; j < dim; j++)
+	  row[j] = m == 0 ? i : j;
+	if (write (fd, row, dim * sizeof (int)) != (int) (dim * sizeof (int)))
+	  {
+	    close (fd);
+	    return false;
+	  }
       }
+  close (fd);
+  return true;
+}
+
+/* Maps A and B from FILE, creating it first if needed.  Returns
+   the start of the mapping, or a null pointer on failure. */
+static int *
+map_input (const char *file)
+{
+  int fd = open (file);
+
+  if (fd < 0)
+    {
+      if (!create_input (file) || (fd = open (file)) < 0)
+	return NULL;
+    }
+  if (filesize (fd) != (int) (2 * dim * dim * sizeof (int))
+      || mmap (fd, MAP_ADDR) == MAP_FAILED)
+    return NULL;
+  return MAP_ADDR;
+}
+
+static void
+usage (void)
+{
+  printf ("usage: matmult [-k naive|tiled] [-t TILE] [-m FILE] [DIM]"
+	  "  (DIM 1 to %d)\n", MAX_DIM);
+  exit (-1);
+}
+
+/* Multiplies A by B into C, with the TILED kernel if set,
+   reading A and B from FILE if it is nonnull.  Returns the last
+   element of the product. */
+static int
+run (int *a, int *b, int *c, const char *file, bool tiled, int tile)
+{
+  struct bench_clock clock;
+
+  if (file != NULL)
+    {
+      a = map_input (file);
+      if (a == NULL)
+	{
+	  printf ("%s: mmap failed\n", file);
+	  exit (-1);
+	}
+      b = a + dim * dim;
+    }
+  printf ("(matmult) dim %d kernel %s tile %d input %s pages %d\n",
+	  dim, tiled ? "tiled" : "naive", tiled ? tile : 0,
+	  file != NULL ? file : dim > STATIC_DIM ? "stack" : "bss",
+	  (int) ((3 * dim * dim * sizeof (int) + PAGE_SIZE - 1) / PAGE_SIZE));
+
+  /* Initialize the matrices. */
+  bench_start (&clock);
+  init (file != NULL ? NULL : a, b, c);
+  bench_stop (&clock, "init", dim * dim);
 
   /* Multiply matrices. */
-  for (i = 0; i < DIM; i++)	
-    for (j = 0; j < DIM; j++)
-      for (k = 0; k < DIM; k++)
-	C[i][j] += A[i][k] * B[k][j];
+  bench_start (&clock);
+  if (tiled)
+    multiply_tiled (a, b, c, tile);
+  else
+    multiply_naive (a, b, c);
+  bench_stop (&clock, "multiply", dim * dim * dim);
+
+  return AT (c, dim - 1, dim - 1);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *file = NULL;
+  bool tiled = false;
+  int tile = DEFAULT_TILE;
+  int i;
+
+  dim = DEFAULT_DIM;
+  for (i = 1; i < argc; i++)
+    if (!strcmp (argv[i], "-k") && i + 1 < argc)
+      {
+	i++;
+	if (!strcmp (argv[i], "tiled"))
+	  tiled = true;
+	else if (strcmp (argv[i], "naive"))
+	  usage ();
+      }
+    else if (!strcmp (argv[i], "-t") && i + 1 < argc)
+      tile = atoi (argv[++i]);
+    else if (!strcmp (argv[i], "-m") && i + 1 < argc)
+      file = argv[++i];
+    else if (argv[i][0] != '-' && i == argc - 1)
+      dim = atoi (argv[i]);
+    else
+      usage ();
+  if (dim < 1 || dim > MAX_DIM || tile < 1)
+    usage ();
+  bench_init ("matmult");
 
-  /* Done. */
-  exit (C[DIM - 1][DIM - 1]);
+  if (dim <= STATIC_DIM)
+    exit (run (A, B, C, file, tiled, tile));
+  else
+    {
+      /* Too big for BSS.  The stack grows into it as it is
+	 touched. */
+      int m[3 * dim * dim];
+      exit (run (m, m + dim * dim, m + 2 * dim * dim, file, tiled, tile));
+    }
 }
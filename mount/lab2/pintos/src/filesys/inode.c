@@ -6,6 +6,9 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#ifdef VM
+#include "vm/pcache.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -176,6 +179,9 @@ inode_close (struct inode *inode)
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+#ifdef VM
+          pcache_drop (inode->sector);
+#endif
           free_map_release (inode->sector, 1);
           free_map_release (inode->data.start,
                             bytes_to_sectors (inode->data.length)); 
@@ -198,7 +204,20 @@ inode_remove (struct inode *inode)
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+#ifdef VM
+  return pcache_read (inode, buffer, size, offset);
+#else
+  return inode_read_uncached (inode, buffer, size, offset);
+#endif
+}
+
+/* Like inode_read_at(), but reads from disk even if the data is
+   in the page cache. */
+off_t
+inode_read_uncached (struct inode *inode, void *buffer_, off_t size,
+                     off_t offset) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
@@ -313,6 +332,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       bytes_written += chunk_size;
     }
   free (bounce);
+#ifdef VM
+  /* Keep cached pages, and processes mapping them, up to date. */
+  pcache_write (inode, buffer_, bytes_written, offset - bytes_written);
+#endif
 
   return bytes_written;
 }
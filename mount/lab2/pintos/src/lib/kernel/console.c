@@ -5,6 +5,7 @@
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
 
 static void vprintf_helper (char, void *);
@@ -87,7 +88,7 @@ console_print_stats (void)
 static void
 acquire_console (void) 
 {
-  if (!intr_context () && use_console_lock) 
+  if (!intr_context () && !softirq_context () && use_console_lock) 
     {
       if (lock_held_by_current_thread (&console_lock)) 
         console_lock_depth++; 
@@ -100,7 +101,7 @@ acquire_console (void)
 static void
 release_console (void) 
 {
-  if (!intr_context () && use_console_lock) 
+  if (!intr_context () && !softirq_context () && use_console_lock) 
     {
       if (console_lock_depth > 0)
         console_lock_depth--;
@@ -115,6 +116,7 @@ static bool
 console_locked_by_current_thread (void) 
 {
   return (intr_context ()
+          || softirq_context ()
           || !use_console_lock
           || lock_held_by_current_thread (&console_lock));
 }
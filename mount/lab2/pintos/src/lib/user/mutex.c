@@ -0,0 +1,70 @@
+#include <mutex.h>
+#include <syscall.h>
+
+/* The three-state mutex of Drepper, "Futexes Are Tricky".  A
+   holder that finds state 1 when unlocking knows that nobody
+   sleeps and skips futex_wake().  A thread that has to sleep sets
+   state 2 first, so that the holder will wake it. */
+
+/* Atomically sets *P to NEW if it is OLD.  Returns the old value
+   of *P. */
+static inline int
+compare_exchange (int *p, int old, int new)
+{
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Atomically sets *P to NEW and returns its old value. */
+static inline int
+exchange (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Initializes M as unlocked. */
+void
+mutex_init (struct mutex *m)
+{
+  m->state = 0;
+}
+
+/* Acquires M, sleeping in the kernel while another thread holds
+   it. */
+void
+mutex_lock (struct mutex *m)
+{
+  int c = compare_exchange (&m->state, 0, 1);
+
+  if (c != 0)
+    {
+      if (c != 2)
+        c = exchange (&m->state, 2);
+      while (c != 0)
+        {
+          futex_wait (&m->state, 2);
+          c = exchange (&m->state, 2);
+        }
+    }
+}
+
+/* Acquires M if it is free and returns true, otherwise returns
+   false at once. */
+bool
+mutex_trylock (struct mutex *m)
+{
+  return compare_exchange (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, waking one sleeper if there may be any. */
+void
+mutex_unlock (struct mutex *m)
+{
+  if (exchange (&m->state, 0) == 2)
+    futex_wake (&m->state, 1);
+}
@@ -0,0 +1,22 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+#include <stdbool.h>
+
+/* A mutual exclusion lock built on a futex.  Locking and
+   unlocking an uncontended mutex is one atomic instruction each,
+   with no system call. */
+struct mutex
+  {
+    int state;                  /* 0: free, 1: held, 2: held, maybe
+                                   with sleepers. */
+  };
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+#endif /* lib/user/mutex.h */
@@ -182,3 +182,41 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+futex_wait (int *addr, int expected)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, expected);
+}
+
+int
+futex_wake (int *addr, int n)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, n);
+}
+
+/* Where a thread created by uthread_create() starts. */
+static void NO_RETURN
+uthread_start (uthread_func *func, void *aux)
+{
+  uthread_exit (func (aux));
+}
+
+uthread_t
+uthread_create (uthread_func *func, void *aux)
+{
+  return syscall3 (SYS_UTHREAD_CREATE, uthread_start, func, aux);
+}
+
+void
+uthread_exit (int status)
+{
+  syscall1 (SYS_UTHREAD_EXIT, status);
+  NOT_REACHED ();
+}
+
+int
+uthread_join (uthread_t tid)
+{
+  return syscall1 (SYS_UTHREAD_JOIN, tid);
+}
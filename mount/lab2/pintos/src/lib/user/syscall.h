@@ -45,4 +45,20 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int futex_wait (int *addr, int expected);
+int futex_wake (int *addr, int n);
+
+/* User thread identifier. */
+typedef int uthread_t;
+#define UTHREAD_ERROR ((uthread_t) -1)
+
+/* A user thread's code.  Returning from it exits the thread with
+   the value returned. */
+typedef int uthread_func (void *aux);
+
+uthread_t uthread_create (uthread_func *, void *aux);
+void uthread_exit (int status) NO_RETURN;
+int uthread_join (uthread_t);
+
 #endif /* lib/user/syscall.h */
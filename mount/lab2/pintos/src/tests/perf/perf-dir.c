@@ -0,0 +1,61 @@
+/* Measures dir_lookup() in the root directory, for names that
+   are present (early and late in the directory) and for a name
+   that is not, which has to scan every entry. */
+
+#include "tests/perf/perf.h"
+#include <stdio.h>
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+
+#define FILE_CNT 12
+#define LOOKUPS 500
+
+static void
+measure (struct dir *dir, const char *name, const char *key, bool present) 
+{
+  struct perf_clock clock;
+  struct inode *inode;
+  int i;
+
+  perf_start (&clock);
+  for (i = 0; i < LOOKUPS; i++) 
+    {
+      if (dir_lookup (dir, name, &inode) != present)
+        perf_fail ("lookup of \"%s\" %s", name,
+                   present ? "failed" : "succeeded");
+      inode_close (inode);
+    }
+  perf_stop (&clock, key, LOOKUPS);
+}
+
+void
+perf_dir (void) 
+{
+  char first[NAME_MAX + 1], last[NAME_MAX + 1];
+  struct dir *dir;
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      char name[NAME_MAX + 1];
+      snprintf (name, sizeof name, "perf%d", i);
+      if (!filesys_create (name, 0))
+        perf_fail ("could not create \"%s\"", name);
+    }
+  snprintf (first, sizeof first, "perf%d", 0);
+  snprintf (last, sizeof last, "perf%d", FILE_CNT - 1);
+
+  dir = dir_open_root ();
+  measure (dir, first, "lookup-first", true);
+  measure (dir, last, "lookup-last", true);
+  measure (dir, "missing", "lookup-missing", false);
+  dir_close (dir);
+
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      char name[NAME_MAX + 1];
+      snprintf (name, sizeof name, "perf%d", i);
+      filesys_remove (name);
+    }
+}
@@ -0,0 +1,76 @@
+/* Measures inode_write_at() and inode_read_at() on a freshly
+   created inode, sequentially and at random block-aligned
+   offsets, for block sizes from one sector to several. */
+
+#include "tests/perf/perf.h"
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+
+#define FILE_SIZE (64 * 1024)
+#define RANDOM_OPS 64
+
+/* Reads or writes BLOCK_SIZE bytes of INODE at a time, through
+   the whole file in order if SEQUENTIAL, otherwise RANDOM_OPS
+   times at random offsets. */
+static void
+measure (struct inode *inode, void *buf, off_t block_size, bool write,
+         bool sequential) 
+{
+  struct perf_clock clock;
+  off_t block_cnt = FILE_SIZE / block_size;
+  long ops = sequential ? block_cnt : RANDOM_OPS;
+  char key[32];
+  long i;
+
+  perf_start (&clock);
+  for (i = 0; i < ops; i++) 
+    {
+      off_t ofs = (sequential ? i : (off_t) (random_ulong () % block_cnt))
+                  * block_size;
+      off_t done = (write
+                    ? inode_write_at (inode, buf, block_size, ofs)
+                    : inode_read_at (inode, buf, block_size, ofs));
+      if (done != block_size)
+        perf_fail ("%s of %d bytes at %d did only %d bytes",
+                   write ? "write" : "read", block_size, ofs, done);
+    }
+  snprintf (key, sizeof key, "%s-%s-%d", sequential ? "seq" : "random",
+            write ? "write" : "read", block_size);
+  perf_stop (&clock, key, ops);
+}
+
+void
+perf_inode (void) 
+{
+  static const off_t block_sizes[] = {512, 4096, 16384};
+  block_sector_t sector;
+  struct inode *inode;
+  void *buf;
+  size_t i;
+
+  random_init (0);
+  buf = malloc (16384);
+  if (buf == NULL)
+    perf_fail ("out of memory");
+  memset (buf, 0x5a, 16384);
+
+  if (!free_map_allocate (1, &sector) || !inode_create (sector, FILE_SIZE))
+    perf_fail ("could not create a %d byte inode", FILE_SIZE);
+  inode = inode_open (sector);
+
+  for (i = 0; i < sizeof block_sizes / sizeof *block_sizes; i++) 
+    {
+      measure (inode, buf, block_sizes[i], true, true);
+      measure (inode, buf, block_sizes[i], false, true);
+      measure (inode, buf, block_sizes[i], true, false);
+      measure (inode, buf, block_sizes[i], false, false);
+    }
+
+  inode_remove (inode);
+  inode_close (inode);
+  free (buf);
+}
@@ -0,0 +1,132 @@
+/* Measures lightweight tasks: spawning tasks that finish in one
+   step, and tasks modelled on the bus of batch-scheduler.c, each
+   taking one of a few slots on a shared bus, yielding while it
+   "transfers", and leaving again.  Also checks that the bus is
+   never over capacity and that sleeping tasks wait out their
+   sleep. */
+
+#include "tests/perf/perf.h"
+#include <stddef.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/ktask.h"
+
+#define TASKS 1000
+#define ROUNDS 10
+#define WORKERS 4
+#define BUS_CAPACITY 3
+#define SLEEPERS 100
+#define SLEEP 3
+
+struct bus_task
+  {
+    struct ktask task;
+    int64_t start;              /* When a sleeper went to sleep. */
+  };
+
+static struct bus_task tasks[TASKS];
+static struct ktask_sema bus;
+static int on_bus;              /* Tasks holding a slot. */
+static int early;               /* Sleepers that woke too soon. */
+
+static enum ktask_status
+finish (struct ktask *t UNUSED)
+{
+  return KTASK_DONE;
+}
+
+static enum ktask_status
+leave_slot (struct ktask *t UNUSED)
+{
+  enum intr_level old_level = intr_disable ();
+  on_bus--;
+  intr_set_level (old_level);
+  ktask_sema_up (&bus);
+  return KTASK_DONE;
+}
+
+static enum ktask_status
+transfer (struct ktask *t)
+{
+  enum intr_level old_level = intr_disable ();
+  int cnt = ++on_bus;
+  intr_set_level (old_level);
+
+  if (cnt > BUS_CAPACITY)
+    perf_fail ("%d tasks on a bus with %d slots", cnt, BUS_CAPACITY);
+  return ktask_yield (t, leave_slot);
+}
+
+static enum ktask_status
+get_slot (struct ktask *t)
+{
+  return ktask_sema_down (t, &bus, transfer);
+}
+
+static enum ktask_status
+wake_up (struct ktask *t)
+{
+  struct bus_task *bt = t->aux;
+
+  if (timer_elapsed (bt->start) < SLEEP)
+    {
+      enum intr_level old_level = intr_disable ();
+      early++;
+      intr_set_level (old_level);
+    }
+  return KTASK_DONE;
+}
+
+static enum ktask_status
+go_to_sleep (struct ktask *t)
+{
+  struct bus_task *bt = t->aux;
+
+  bt->start = timer_ticks ();
+  return ktask_sleep (t, SLEEP, wake_up);
+}
+
+/* Spawns the first CNT tasks on POOL, each starting with FUNC,
+   and waits for them. */
+static void
+run_tasks (struct ktask_pool *pool, ktask_func *func, int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      ktask_init (&tasks[i].task, func, &tasks[i]);
+      ktask_spawn (pool, &tasks[i].task);
+    }
+  ktask_pool_wait (pool);
+}
+
+void
+perf_ktask (void)
+{
+  struct ktask_pool *pool;
+  struct perf_clock clock;
+  int i;
+
+  pool = ktask_pool_create ("perf", WORKERS);
+  if (pool == NULL)
+    perf_fail ("ktask_pool_create failed");
+  perf_msg ("%zu bytes per task", sizeof (struct ktask));
+
+  perf_start (&clock);
+  for (i = 0; i < ROUNDS; i++)
+    run_tasks (pool, finish, TASKS);
+  perf_stop (&clock, "spawn", TASKS * ROUNDS);
+
+  ktask_sema_init (&bus, BUS_CAPACITY);
+  perf_start (&clock);
+  for (i = 0; i < ROUNDS; i++)
+    run_tasks (pool, get_slot, TASKS);
+  perf_stop (&clock, "bus", TASKS * ROUNDS);
+  if (on_bus != 0)
+    perf_fail ("%d tasks left on the bus", on_bus);
+
+  run_tasks (pool, go_to_sleep, SLEEPERS);
+  if (early != 0)
+    perf_fail ("%d of %d sleepers woke early", early, SLEEPERS);
+}
@@ -0,0 +1,68 @@
+/* Measures lock handoff between two threads that each hold the
+   lock across a thread_yield(), so that every acquire by one
+   of them finds the lock held and has to block until the
+   other releases it.  Also measures lock_acquire/lock_release
+   pairs without contention. */
+
+#include "tests/perf/perf.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define HANDOFFS 1000
+#define PAIRS 20000
+
+struct contention 
+  {
+    struct lock lock;           /* The contended lock. */
+    struct semaphore done;      /* Upped when the partner exits. */
+  };
+
+/* Acquires the lock HANDOFFS times, yielding while holding it. */
+static void
+contend (struct contention *c) 
+{
+  int i;
+
+  for (i = 0; i < HANDOFFS; i++) 
+    {
+      lock_acquire (&c->lock);
+      thread_yield ();
+      lock_release (&c->lock);
+    }
+}
+
+static void
+partner (void *c_) 
+{
+  struct contention *c = c_;
+
+  contend (c);
+  sema_up (&c->done);
+}
+
+void
+perf_lock (void) 
+{
+  struct contention c;
+  struct perf_clock clock;
+  struct lock lock;
+  int i;
+
+  lock_init (&c.lock);
+  sema_init (&c.done, 0);
+
+  perf_start (&clock);
+  thread_create ("partner", thread_get_priority (), partner, &c);
+  contend (&c);
+  sema_down (&c.done);
+  perf_stop (&clock, "handoff", 2 * HANDOFFS);
+
+  lock_init (&lock);
+  perf_start (&clock);
+  for (i = 0; i < PAIRS; i++) 
+    {
+      lock_acquire (&lock);
+      lock_release (&lock);
+    }
+  perf_stop (&clock, "uncontended", PAIRS);
+}
@@ -0,0 +1,46 @@
+/* Measures malloc() and free() for every block size class, and
+   for a block too big for any class.  Each round allocates a
+   batch of blocks and then frees them all, so that arenas are
+   both carved up and given back. */
+
+#include "tests/perf/perf.h"
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+#define BATCH 64
+#define ROUNDS 50
+
+static void
+measure (size_t size) 
+{
+  void *blocks[BATCH];
+  struct perf_clock clock;
+  char key[32];
+  int round, i;
+
+  perf_start (&clock);
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      for (i = 0; i < BATCH; i++) 
+        {
+          blocks[i] = malloc (size);
+          if (blocks[i] == NULL)
+            perf_fail ("malloc (%zu) failed", size);
+        }
+      for (i = 0; i < BATCH; i++)
+        free (blocks[i]);
+    }
+  snprintf (key, sizeof key, "malloc-free-%zu", size);
+  perf_stop (&clock, key, ROUNDS * BATCH);
+}
+
+void
+perf_malloc (void) 
+{
+  size_t size;
+
+  for (size = 16; size < PGSIZE / 2; size *= 2)
+    measure (size);
+  measure (PGSIZE);
+}
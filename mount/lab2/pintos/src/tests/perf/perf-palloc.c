@@ -0,0 +1,46 @@
+/* Measures palloc_get_page() and palloc_get_multiple() with
+   their matching frees, for single pages and for runs of
+   several contiguous pages.  At most BATCH_PAGES pages are held
+   at once, well within the kernel pool of a 4 MB machine. */
+
+#include "tests/perf/perf.h"
+#include <stdio.h>
+#include "threads/palloc.h"
+
+#define BATCH_PAGES 32
+#define ROUNDS 20
+
+static void
+measure (size_t page_cnt) 
+{
+  void *pages[BATCH_PAGES];
+  int batch = BATCH_PAGES / page_cnt;
+  struct perf_clock clock;
+  char key[32];
+  int round, i;
+
+  ASSERT (batch > 0);
+
+  perf_start (&clock);
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      for (i = 0; i < batch; i++) 
+        {
+          pages[i] = palloc_get_multiple (0, page_cnt);
+          if (pages[i] == NULL)
+            perf_fail ("palloc_get_multiple (0, %zu) failed", page_cnt);
+        }
+      for (i = 0; i < batch; i++)
+        palloc_free_multiple (pages[i], page_cnt);
+    }
+  snprintf (key, sizeof key, "pages-%zu", page_cnt);
+  perf_stop (&clock, key, ROUNDS * batch);
+}
+
+void
+perf_palloc (void) 
+{
+  measure (1);
+  measure (4);
+  measure (16);
+}
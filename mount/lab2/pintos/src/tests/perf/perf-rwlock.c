@@ -0,0 +1,134 @@
+/* Measures a readers-writer lock shared by READERS reader and
+   WRITERS writer threads, each of which holds it across a
+   thread_yield(), so that readers pile up in the lock together
+   and writers have to wait them out.  Checks that writers
+   exclude everyone else and that readers never see a write half
+   done.  Also measures read and write acquire/release pairs
+   without contention. */
+
+#include "tests/perf/perf.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READERS 4
+#define WRITERS 2
+#define READS 500               /* Per reader. */
+#define WRITES 100              /* Per writer. */
+#define PAIRS 20000
+
+struct shared
+  {
+    struct rwlock rw;           /* The contended lock. */
+    int a, b;                   /* Writers keep these equal. */
+    int readers;                /* Readers inside now. */
+    int max_readers;            /* Most readers inside at once. */
+    bool writing;               /* A writer inside now? */
+    struct semaphore done;      /* Upped when a thread exits. */
+  };
+
+static void
+reader (void *s_)
+{
+  struct shared *s = s_;
+  int i;
+
+  for (i = 0; i < READS; i++)
+    {
+      int a;
+
+      rwlock_acquire_read (&s->rw);
+      if (s->writing)
+        perf_fail ("reader got in while a writer was inside");
+      if (++s->readers > s->max_readers)
+        s->max_readers = s->readers;
+      a = s->a;
+      thread_yield ();
+      if (s->b != a)
+        perf_fail ("reader saw a = %d, b = %d", a, s->b);
+      s->readers--;
+      rwlock_release_read (&s->rw);
+    }
+  sema_up (&s->done);
+}
+
+static void
+writer (void *s_)
+{
+  struct shared *s = s_;
+  int i;
+
+  for (i = 0; i < WRITES; i++)
+    {
+      rwlock_acquire_write (&s->rw);
+      if (s->writing || s->readers > 0)
+        perf_fail ("writer got in while the lock was held");
+      s->writing = true;
+      s->a++;
+      thread_yield ();
+      s->b++;
+      s->writing = false;
+      rwlock_release_write (&s->rw);
+    }
+  sema_up (&s->done);
+}
+
+/* Checks that upgrading waits out other readers and that
+   downgrading keeps the lock shared. */
+static void
+check_upgrade (struct shared *s)
+{
+  rwlock_acquire_read (&s->rw);
+  if (!rwlock_upgrade (&s->rw) || !rwlock_held_for_write (&s->rw))
+    perf_fail ("upgrade of sole reader failed");
+  rwlock_downgrade (&s->rw);
+  if (rwlock_held_for_write (&s->rw))
+    perf_fail ("downgrade kept write hold");
+  rwlock_release_read (&s->rw);
+}
+
+void
+perf_rwlock (void)
+{
+  struct shared s;
+  struct perf_clock clock;
+  struct rwlock rw;
+  int i;
+
+  rwlock_init (&s.rw);
+  s.a = s.b = 0;
+  s.readers = s.max_readers = 0;
+  s.writing = false;
+  sema_init (&s.done, 0);
+
+  perf_start (&clock);
+  for (i = 0; i < READERS; i++)
+    thread_create ("reader", thread_get_priority (), reader, &s);
+  for (i = 0; i < WRITERS; i++)
+    thread_create ("writer", thread_get_priority (), writer, &s);
+  for (i = 0; i < READERS + WRITERS; i++)
+    sema_down (&s.done);
+  perf_stop (&clock, "mixed", READERS * READS + WRITERS * WRITES);
+
+  if (s.a != WRITERS * WRITES || s.b != s.a)
+    perf_fail ("a = %d, b = %d after %d writes", s.a, s.b, WRITERS * WRITES);
+  perf_msg ("at most %d of %d readers inside at once",
+            s.max_readers, READERS);
+  check_upgrade (&s);
+
+  rwlock_init (&rw);
+  perf_start (&clock);
+  for (i = 0; i < PAIRS; i++)
+    {
+      rwlock_acquire_read (&rw);
+      rwlock_release_read (&rw);
+    }
+  perf_stop (&clock, "read", PAIRS);
+
+  perf_start (&clock);
+  for (i = 0; i < PAIRS; i++)
+    {
+      rwlock_acquire_write (&rw);
+      rwlock_release_write (&rw);
+    }
+  perf_stop (&clock, "write", PAIRS);
+}
@@ -0,0 +1,65 @@
+/* Measures context switch round trips: two threads hand a
+   token back and forth through a pair of semaphores, so every
+   round trip is two sema_up/sema_down pairs and two thread
+   switches.  Also measures sema_up/sema_down pairs that never
+   block. */
+
+#include "tests/perf/perf.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUND_TRIPS 2000
+#define PAIRS 20000
+
+struct ping_pong 
+  {
+    struct semaphore ping;      /* Upped by the main thread. */
+    struct semaphore pong;      /* Upped by the partner thread. */
+    struct semaphore done;      /* Upped when the partner exits. */
+  };
+
+static void
+partner (void *pp_) 
+{
+  struct ping_pong *pp = pp_;
+  int i;
+
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_down (&pp->ping);
+      sema_up (&pp->pong);
+    }
+  sema_up (&pp->done);
+}
+
+void
+perf_sema (void) 
+{
+  struct ping_pong pp;
+  struct perf_clock clock;
+  struct semaphore sema;
+  int i;
+
+  sema_init (&pp.ping, 0);
+  sema_init (&pp.pong, 0);
+  sema_init (&pp.done, 0);
+  thread_create ("partner", thread_get_priority (), partner, &pp);
+
+  perf_start (&clock);
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+    }
+  perf_stop (&clock, "round-trip", ROUND_TRIPS);
+  sema_down (&pp.done);
+
+  sema_init (&sema, 0);
+  perf_start (&clock);
+  for (i = 0; i < PAIRS; i++) 
+    {
+      sema_up (&sema);
+      sema_down (&sema);
+    }
+  perf_stop (&clock, "uncontended", PAIRS);
+}
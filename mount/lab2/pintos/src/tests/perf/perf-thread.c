@@ -0,0 +1,52 @@
+/* Measures thread creation: creating a thread that exits at once
+   and waiting for it, one at a time, which the cache of dead
+   threads' pages should serve entirely, and in bursts of more
+   threads than the cache holds. */
+
+#include "tests/perf/perf.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUNDS 1000
+#define BURST 40
+#define BURST_ROUNDS 25
+
+static struct semaphore exited;
+
+static void
+exiter (void *aux UNUSED)
+{
+  sema_up (&exited);
+}
+
+/* Creates CNT threads, then waits for all of them. */
+static void
+create_and_wait (int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    if (thread_create ("exiter", PRI_DEFAULT, exiter, NULL) == TID_ERROR)
+      perf_fail ("thread_create failed");
+  for (i = 0; i < cnt; i++)
+    sema_down (&exited);
+}
+
+void
+perf_thread (void)
+{
+  struct perf_clock clock;
+  int i;
+
+  sema_init (&exited, 0);
+
+  perf_start (&clock);
+  for (i = 0; i < ROUNDS; i++)
+    create_and_wait (1);
+  perf_stop (&clock, "create-exit", ROUNDS);
+
+  perf_start (&clock);
+  for (i = 0; i < BURST_ROUNDS; i++)
+    create_and_wait (BURST);
+  perf_stop (&clock, "burst", BURST * BURST_ROUNDS);
+}
@@ -0,0 +1,48 @@
+/* Measures how late timer_sleep() wakes a thread.  Every sleep
+   starts right after a tick, so a sleep of N ticks should
+   return exactly N ticks later; the ticks beyond that are
+   reported as lateness. */
+
+#include "tests/perf/perf.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+
+#define SLEEPS 20
+
+static void
+measure (int64_t sleep_ticks) 
+{
+  struct perf_clock clock;
+  int64_t late = 0;
+  int64_t worst = 0;
+  char key[32];
+  int i;
+
+  perf_start (&clock);
+  for (i = 0; i < SLEEPS; i++) 
+    {
+      int64_t start, overshoot;
+
+      timer_sleep (1);
+      start = timer_ticks ();
+      timer_sleep (sleep_ticks);
+      overshoot = timer_elapsed (start) - sleep_ticks;
+      if (overshoot < 0)
+        perf_fail ("woke up %"PRId64" ticks early", -overshoot);
+      late += overshoot;
+      if (overshoot > worst)
+        worst = overshoot;
+    }
+  snprintf (key, sizeof key, "sleep-%"PRId64, sleep_ticks);
+  perf_stop (&clock, key, SLEEPS);
+  perf_msg ("%s late %"PRId64" ticks, worst %"PRId64, key, late, worst);
+}
+
+void
+perf_timer (void) 
+{
+  measure (1);
+  measure (2);
+  measure (5);
+}
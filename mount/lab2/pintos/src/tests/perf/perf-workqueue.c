@@ -0,0 +1,102 @@
+/* Measures work queues: the round trip of queueing one item and
+   waiting for a worker to run it, and the throughput of a batch
+   of items spread over several workers and waited for with
+   workqueue_flush().  Also checks that delayed items wait out
+   their delay and that cancelled items do not run. */
+
+#include "tests/perf/perf.h"
+#include <inttypes.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/workqueue.h"
+
+#define ROUND_TRIPS 2000
+#define BATCH 200
+#define BATCH_ROUNDS 10
+#define BATCH_WORKERS 4
+#define DELAY 5
+
+static struct semaphore ran;
+static int batch_cnt;
+static int64_t ran_at;
+
+static void
+signal_work (struct work *w UNUSED)
+{
+  ran_at = timer_ticks ();
+  sema_up (&ran);
+}
+
+static void
+count_work (struct work *w UNUSED)
+{
+  enum intr_level old_level = intr_disable ();
+  batch_cnt++;
+  intr_set_level (old_level);
+}
+
+static void
+unexpected_work (struct work *w UNUSED)
+{
+  perf_fail ("cancelled work ran");
+}
+
+void
+perf_workqueue (void)
+{
+  static struct work batch[BATCH];
+  struct workqueue *one, *many;
+  struct perf_clock clock;
+  struct work w, never;
+  int64_t start;
+  int i, j;
+
+  one = workqueue_create ("perf-one", 1);
+  many = workqueue_create ("perf-many", BATCH_WORKERS);
+  if (one == NULL || many == NULL)
+    perf_fail ("workqueue_create failed");
+  sema_init (&ran, 0);
+
+  work_init (&w, signal_work, NULL);
+  perf_start (&clock);
+  for (i = 0; i < ROUND_TRIPS; i++)
+    {
+      work_queue (one, &w);
+      sema_down (&ran);
+    }
+  perf_stop (&clock, "round-trip", ROUND_TRIPS);
+
+  for (i = 0; i < BATCH; i++)
+    work_init (&batch[i], count_work, NULL);
+  perf_start (&clock);
+  for (j = 0; j < BATCH_ROUNDS; j++)
+    {
+      for (i = 0; i < BATCH; i++)
+        if (!work_queue (many, &batch[i]))
+          perf_fail ("idle work reported pending");
+      workqueue_flush (many);
+    }
+  perf_stop (&clock, "batch", BATCH * BATCH_ROUNDS);
+  if (batch_cnt != BATCH * BATCH_ROUNDS)
+    perf_fail ("%d of %d items ran", batch_cnt, BATCH * BATCH_ROUNDS);
+
+  /* Delayed work. */
+  timer_sleep (1);
+  start = timer_ticks ();
+  if (!work_queue_delayed (one, &w, DELAY) || work_queue (one, &w))
+    perf_fail ("delayed work not pending");
+  sema_down (&ran);
+  if (ran_at - start < DELAY)
+    perf_fail ("delayed work ran after %"PRId64" of %d ticks",
+               ran_at - start, DELAY);
+  perf_msg ("delayed work ran %"PRId64" ticks late", ran_at - start - DELAY);
+
+  /* Cancellation. */
+  work_init (&never, unexpected_work, NULL);
+  work_queue_delayed (one, &never, DELAY);
+  if (!work_cancel (&never) || work_pending (&never))
+    perf_fail ("delayed work not cancelled");
+  timer_sleep (2 * DELAY);
+  workqueue_flush (one);
+}
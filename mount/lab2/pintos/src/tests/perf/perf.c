@@ -0,0 +1,110 @@
+#include "tests/perf/perf.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+
+struct perf 
+  {
+    const char *name;
+    perf_func *function;
+  };
+
+static const struct perf benchmarks[] = 
+  {
+    {"perf-sema", perf_sema},
+    {"perf-lock", perf_lock},
+    {"perf-rwlock", perf_rwlock},
+    {"perf-malloc", perf_malloc},
+    {"perf-palloc", perf_palloc},
+    {"perf-timer", perf_timer},
+    {"perf-workqueue", perf_workqueue},
+    {"perf-thread", perf_thread},
+    {"perf-ktask", perf_ktask},
+#ifdef FILESYS
+    {"perf-inode", perf_inode},
+    {"perf-dir", perf_dir},
+#endif
+  };
+
+static const char *perf_name;
+
+/* Runs the benchmark named NAME. */
+void
+run_perf (const char *name) 
+{
+  const struct perf *p;
+
+  for (p = benchmarks; p < benchmarks + sizeof benchmarks / sizeof *benchmarks;
+       p++)
+    if (!strcmp (name, p->name))
+      {
+        perf_name = name;
+        perf_msg ("begin");
+        p->function ();
+        perf_msg ("PASS");
+        perf_msg ("end");
+        return;
+      }
+  PANIC ("no benchmark named \"%s\"", name);
+}
+
+/* Starts measuring into CLOCK.  Waits for the start of a timer
+   tick first, so that the tick count is not off by one
+   depending on where in a tick the measurement began. */
+void
+perf_start (struct perf_clock *clock) 
+{
+  int64_t start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  clock->ticks = timer_ticks ();
+  clock->cycles = perf_cycles ();
+}
+
+/* Stops measuring CLOCK and prints the result line for OPS
+   operations of kind KEY. */
+void
+perf_stop (struct perf_clock *clock, const char *key, long ops) 
+{
+  uint64_t cycles = perf_cycles () - clock->cycles;
+  int64_t ticks = timer_elapsed (clock->ticks);
+
+  perf_msg ("result %s ops %ld ticks %"PRId64" cycles %"PRIu64,
+            key, ops, ticks, cycles);
+}
+
+/* Prints FORMAT as if with printf(),
+   prefixing the output by the name of the benchmark
+   and following it with a new-line character. */
+void
+perf_msg (const char *format, ...) 
+{
+  va_list args;
+  
+  printf ("(%s) ", perf_name);
+  va_start (args, format);
+  vprintf (format, args);
+  va_end (args);
+  putchar ('\n');
+}
+
+/* Prints failure message FORMAT as if with printf(),
+   prefixing the output by the name of the benchmark and FAIL:
+   and following it with a new-line character,
+   and then panics the kernel. */
+void
+perf_fail (const char *format, ...) 
+{
+  va_list args;
+  
+  printf ("(%s) FAIL: ", perf_name);
+  va_start (args, format);
+  vprintf (format, args);
+  va_end (args);
+  putchar ('\n');
+
+  PANIC ("benchmark failed");
+}
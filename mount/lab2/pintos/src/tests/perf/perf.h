@@ -0,0 +1,58 @@
+#ifndef TESTS_PERF_PERF_H
+#define TESTS_PERF_PERF_H
+
+#include <debug.h>
+#include <stdint.h>
+
+/* Kernel microbenchmarks.
+
+   Each benchmark prints one or more result lines of the form
+
+     (perf-NAME) result KEY ops N ticks T cycles C
+
+   where KEY names the measured operation, N is the number of
+   operations, T the timer ticks and C the time stamp counter
+   cycles they took in total.  tests/make-grade compares the
+   cycles per operation against tests/perf/Baseline. */
+
+void run_perf (const char *);
+
+typedef void perf_func (void);
+
+extern perf_func perf_sema;
+extern perf_func perf_lock;
+extern perf_func perf_rwlock;
+extern perf_func perf_malloc;
+extern perf_func perf_palloc;
+extern perf_func perf_timer;
+extern perf_func perf_workqueue;
+extern perf_func perf_thread;
+extern perf_func perf_ktask;
+#ifdef FILESYS
+extern perf_func perf_inode;
+extern perf_func perf_dir;
+#endif
+
+/* A measurement in progress. */
+struct perf_clock
+  {
+    int64_t ticks;              /* timer_ticks() at start. */
+    uint64_t cycles;            /* Time stamp counter at start. */
+  };
+
+void perf_start (struct perf_clock *);
+void perf_stop (struct perf_clock *, const char *key, long ops);
+
+void perf_msg (const char *, ...) PRINTF_FORMAT (1, 2);
+void perf_fail (const char *, ...) PRINTF_FORMAT (1, 2) NO_RETURN;
+
+/* Reads the processor's time stamp counter. */
+static inline uint64_t
+perf_cycles (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* tests/perf/perf.h */
@@ -0,0 +1,31 @@
+sub check_perf {
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+
+    my ($name) = $test =~ m%([^/]+)$%;
+    my ($begin, $end, $passed, $results) = (0, 0, 0, 0);
+    local ($_);
+    foreach (@output) {
+	next if !/^\($name\) (.*)$/;
+	my ($line) = $1;
+	if ($line eq 'begin') {
+	    $begin++;
+	} elsif ($line eq 'end') {
+	    $end++;
+	} elsif ($line eq 'PASS') {
+	    $passed++;
+	} elsif ($line =~ /^result /) {
+	    fail "Malformed result line: $_\n"
+	      if $line !~ /^result \S+ ops [1-9]\d* ticks \d+ cycles \d+$/;
+	    $results++;
+	}
+    }
+    fail "Benchmark did not begin.\n" if !$begin;
+    fail "Benchmark printed no results.\n" if !$results;
+    fail "Benchmark did not pass.\n" if !$passed;
+    fail "Benchmark did not end.\n" if !$end;
+    pass;
+}
+
+1;
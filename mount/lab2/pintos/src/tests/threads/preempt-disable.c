@@ -0,0 +1,52 @@
+/* Tests preempt_disable(): a thread that disables preemption
+   keeps the CPU past the end of its time slice, though timer
+   interrupts keep arriving, and gives it up as soon as it
+   enables preemption again. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Ticks to hold the CPU, several time slices. */
+#define HOLD_TICKS 20
+
+/* Set by the other thread when it runs. */
+static volatile bool other_ran;
+
+static void
+other (void *done_)
+{
+  struct semaphore *done = done_;
+
+  other_ran = true;
+  sema_up (done);
+}
+
+void
+test_preempt_disable (void)
+{
+  struct semaphore done;
+  int64_t start;
+
+  sema_init (&done, 0);
+  other_ran = false;
+
+  preempt_disable ();
+  thread_create ("other", PRI_DEFAULT, other, &done);
+  start = timer_ticks ();
+  while (timer_elapsed (start) < HOLD_TICKS)
+    continue;
+  if (other_ran)
+    fail ("other thread ran with preemption disabled");
+  msg ("held the CPU for %d ticks", HOLD_TICKS);
+
+  preempt_enable ();
+  if (!other_ran)
+    fail ("preempt_enable did not yield");
+  sema_down (&done);
+  msg ("yielded on preempt_enable");
+
+  pass ();
+}
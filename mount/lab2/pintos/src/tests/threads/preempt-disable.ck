@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(preempt-disable) begin
+(preempt-disable) held the CPU for 20 ticks
+(preempt-disable) yielded on preempt_enable
+(preempt-disable) PASS
+(preempt-disable) end
+EOF
+pass;
@@ -0,0 +1,102 @@
+/* Tests tasklets: one scheduled from a timeout, which runs in
+   the timer's softirq, must run once however often it was
+   scheduled, with interrupts on and outside interrupt context;
+   one scheduled from a thread must run by way of ksoftirqd; and
+   one that schedules itself must run once per scheduling. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/softirq.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
+
+/* Times a self-scheduling tasklet runs. */
+#define RESCHEDULES 5
+
+struct probe
+  {
+    struct tasklet tasklet;
+    struct semaphore done;      /* Upped each run. */
+    int runs;                   /* Times run. */
+    int bad_level;              /* Runs with interrupts off. */
+    int bad_context;            /* Runs in the wrong context. */
+    int again;                  /* Runs left to schedule itself. */
+  };
+
+static void
+probe_run (struct tasklet *t)
+{
+  struct probe *p = t->aux;
+
+  p->runs++;
+  if (intr_get_level () != INTR_ON)
+    p->bad_level++;
+  if (intr_context () || !softirq_context ())
+    p->bad_context++;
+  if (p->again > 0)
+    {
+      p->again--;
+      tasklet_schedule (&p->tasklet);
+    }
+  sema_up (&p->done);
+}
+
+static void
+probe_init (struct probe *p, int again)
+{
+  tasklet_init (&p->tasklet, probe_run, p);
+  sema_init (&p->done, 0);
+  p->runs = p->bad_level = p->bad_context = 0;
+  p->again = again;
+}
+
+/* Waits for P to run RUNS times in all and checks how. */
+static void
+probe_check (struct probe *p, const char *what, int runs)
+{
+  int i;
+
+  for (i = 0; i < runs; i++)
+    if (!sema_down_timeout (&p->done, timer_ticks () + 100))
+      fail ("%s: tasklet ran %d times, expected %d", what, i, runs);
+  timer_sleep (2);
+  if (p->runs != runs)
+    fail ("%s: tasklet ran %d times, expected %d", what, p->runs, runs);
+  if (p->bad_level != 0)
+    fail ("%s: tasklet ran with interrupts off", what);
+  if (p->bad_context != 0)
+    fail ("%s: tasklet ran outside softirq context", what);
+  msg ("%s ok", what);
+}
+
+/* Schedules a tasklet twice from the timer's softirq. */
+static void
+schedule_twice (void *p_)
+{
+  struct probe *p = p_;
+
+  tasklet_schedule (&p->tasklet);
+  tasklet_schedule (&p->tasklet);
+}
+
+void
+test_softirq_tasklet (void)
+{
+  struct timer_timeout timeout;
+  struct probe p;
+
+  probe_init (&p, 0);
+  timer_timeout_add (&timeout, timer_ticks () + 2, schedule_twice, &p);
+  probe_check (&p, "from softirq", 1);
+
+  probe_init (&p, 0);
+  tasklet_schedule (&p.tasklet);
+  probe_check (&p, "from thread", 1);
+
+  probe_init (&p, RESCHEDULES - 1);
+  tasklet_schedule (&p.tasklet);
+  probe_check (&p, "rescheduled", RESCHEDULES);
+
+  pass ();
+}
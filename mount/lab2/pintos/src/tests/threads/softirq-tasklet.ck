@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(softirq-tasklet) begin
+(softirq-tasklet) from softirq ok
+(softirq-tasklet) from thread ok
+(softirq-tasklet) rescheduled ok
+(softirq-tasklet) PASS
+(softirq-tasklet) end
+EOF
+pass;
@@ -0,0 +1,121 @@
+/* Tests sema_down_timeout(), lock_acquire_timeout() and
+   cond_wait_timeout(): each must give up at its deadline when
+   nothing wakes it, and must succeed before the deadline when
+   another thread wakes it in time. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+struct shared
+  {
+    struct semaphore sema;
+    struct lock lock;
+    struct condition cond;
+    struct semaphore done;      /* Upped when a helper exits. */
+  };
+
+/* Ups the semaphore after a short sleep. */
+static void
+upper (void *s_)
+{
+  struct shared *s = s_;
+
+  timer_sleep (2);
+  sema_up (&s->sema);
+  sema_up (&s->done);
+}
+
+/* Holds the lock for a while. */
+static void
+holder (void *s_)
+{
+  struct shared *s = s_;
+
+  lock_acquire (&s->lock);
+  sema_up (&s->sema);
+  timer_sleep (10);
+  lock_release (&s->lock);
+  sema_up (&s->done);
+}
+
+/* Signals the condition after a short sleep. */
+static void
+signaler (void *s_)
+{
+  struct shared *s = s_;
+
+  timer_sleep (2);
+  lock_acquire (&s->lock);
+  cond_signal (&s->cond, &s->lock);
+  lock_release (&s->lock);
+  sema_up (&s->done);
+}
+
+/* Fails unless the wait for WHAT, which returned SUCCESS, gave
+   up no earlier than DEADLINE. */
+static void
+check_timed_out (const char *what, bool success, int64_t deadline)
+{
+  if (success)
+    fail ("%s succeeded with nothing to wake it", what);
+  if (timer_ticks () < deadline)
+    fail ("%s gave up %lld ticks early", what,
+          (long long) (deadline - timer_ticks ()));
+}
+
+void
+test_synch_timeout (void)
+{
+  struct shared s;
+  int64_t deadline;
+
+  sema_init (&s.sema, 0);
+  lock_init (&s.lock);
+  cond_init (&s.cond);
+  sema_init (&s.done, 0);
+
+  /* Semaphores. */
+  deadline = timer_ticks () + 5;
+  check_timed_out ("sema_down_timeout", sema_down_timeout (&s.sema, deadline),
+                   deadline);
+  if (sema_down_timeout (&s.sema, timer_ticks () - 1))
+    fail ("sema_down_timeout with a past deadline succeeded");
+  thread_create ("upper", PRI_DEFAULT, upper, &s);
+  if (!sema_down_timeout (&s.sema, timer_ticks () + 100))
+    fail ("sema_down_timeout missed sema_up");
+  sema_down (&s.done);
+  msg ("semaphore ok");
+
+  /* Locks. */
+  thread_create ("holder", PRI_DEFAULT, holder, &s);
+  sema_down (&s.sema);
+  deadline = timer_ticks () + 3;
+  check_timed_out ("lock_acquire_timeout",
+                   lock_acquire_timeout (&s.lock, deadline), deadline);
+  if (!lock_acquire_timeout (&s.lock, timer_ticks () + 100))
+    fail ("lock_acquire_timeout missed lock_release");
+  if (!lock_held_by_current_thread (&s.lock))
+    fail ("lock_acquire_timeout did not take the lock");
+  lock_release (&s.lock);
+  sema_down (&s.done);
+  msg ("lock ok");
+
+  /* Condition variables. */
+  lock_acquire (&s.lock);
+  deadline = timer_ticks () + 5;
+  check_timed_out ("cond_wait_timeout",
+                   cond_wait_timeout (&s.cond, &s.lock, deadline), deadline);
+  if (!lock_held_by_current_thread (&s.lock))
+    fail ("cond_wait_timeout returned without the lock");
+  thread_create ("signaler", PRI_DEFAULT, signaler, &s);
+  if (!cond_wait_timeout (&s.cond, &s.lock, timer_ticks () + 100))
+    fail ("cond_wait_timeout missed cond_signal");
+  lock_release (&s.lock);
+  sema_down (&s.done);
+  msg ("condition ok");
+
+  pass ();
+}
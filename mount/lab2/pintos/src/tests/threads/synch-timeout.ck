@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(synch-timeout) begin
+(synch-timeout) semaphore ok
+(synch-timeout) lock ok
+(synch-timeout) condition ok
+(synch-timeout) PASS
+(synch-timeout) end
+EOF
+pass;
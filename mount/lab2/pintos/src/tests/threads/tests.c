@@ -17,6 +17,9 @@ static const struct test tests[] =
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
     {"batch-scheduler", test_batch_scheduler},
+    {"synch-timeout", test_synch_timeout},
+    {"softirq-tasklet", test_softirq_tasklet},
+    {"preempt-disable", test_preempt_disable},
   };
 
 static const char *test_name;
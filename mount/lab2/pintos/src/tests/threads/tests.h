@@ -13,6 +13,9 @@ extern test_func test_alarm_negative;
 /*extern test_func test_producer_consumer;
 extern test_func test_narrow_bridge;*/
 extern test_func test_batch_scheduler;
+extern test_func test_synch_timeout;
+extern test_func test_softirq_tasklet;
+extern test_func test_preempt_disable;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -21,7 +21,10 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "tests/perf/perf.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -37,6 +40,14 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/pcache.h"
+#include "vm/stats.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -119,11 +130,24 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  softirq_start ();
+  workqueue_init ();
+
+#ifdef VM
+  /* Initialize virtual memory.  The file system reads through the
+     page cache, so this comes first. */
+  frame_init ();
+  page_init ();
+  pcache_init ();
+#endif
 
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
   locate_block_devices ();
+#ifdef VM
+  swap_init ();
+#endif
   filesys_init (format_filesys);
 #endif
 
@@ -251,6 +275,16 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-vmstat"))
+        vm_stats_per_process = true;
+      else if (!strcmp (name, "-vmwindow"))
+        frame_ws_window = atoi (value);
+      else if (!strcmp (name, "-vmreserve"))
+        frame_min_resident = atoi (value);
+      else if (!strcmp (name, "-zswap"))
+        zswap_pool_pages = atoi (value);
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -292,6 +326,17 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Runs the kernel benchmark specified in ARGV[1]. */
+static void
+run_benchmark (char **argv)
+{
+  const char *benchmark = argv[1];
+  
+  printf ("Executing '%s':\n", benchmark);
+  run_perf (benchmark);
+  printf ("Execution of '%s' complete.\n", benchmark);
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -309,6 +354,7 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"perf", 2, run_benchmark},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -357,6 +403,7 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  perf BENCHMARK     Run kernel BENCHMARK from tests/perf.\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -381,6 +428,12 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -vmstat            Print paging statistics of each process.\n"
+          "  -vmwindow=TICKS    Set the WSClock working set window (default 50).\n"
+          "  -vmreserve=COUNT   Never evict a process below COUNT pages (16).\n"
+          "  -zswap=PAGES       Compress swapped pages into PAGES of RAM (64).\n"
 #endif
           );
   shutdown_power_off ();
@@ -6,9 +6,14 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/uthread.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -345,6 +350,7 @@ void
 intr_handler (struct intr_frame *frame) 
 {
   bool external;
+  bool yield;
   intr_handler_func *handler;
 
   /* External interrupts are special.
@@ -383,9 +389,28 @@ intr_handler (struct intr_frame *frame)
       in_external_intr = false;
       pic_end_of_interrupt (frame->vec_no); 
 
-      if (yield_on_return) 
-        thread_yield (); 
+      /* Run deferred work with interrupts on.  An interrupt that
+         arrives meanwhile leaves yielding to the run it
+         interrupted. */
+      yield = yield_on_return;
+      if (!softirq_context ())
+        {
+          softirq_run ();
+          if (yield || yield_on_return) 
+            thread_yield (); 
+        }
     }
+
+#ifdef USERPROG
+  /* A thread of a process that another thread is ending exits
+     here rather than going back to user mode, so that a thread
+     spinning in user code cannot keep its process alive. */
+  if (frame->cs == SEL_UCSEG && uthread_dying ())
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -0,0 +1,327 @@
+#include "threads/ktask.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Lightweight tasks.
+
+   A kernel thread costs a page for its stack and struct thread,
+   and the scheduler a context switch each time it runs, which
+   rules out having thousands of them.  A task is stackless
+   instead: it is a chain of steps, functions that each run to
+   completion and name the step to run next.  State that lives
+   across steps goes in the structure that embeds the struct
+   ktask, so a task costs that structure and nothing more.
+
+   A pool runs its tasks' steps on a few worker threads of its
+   own.  Where a thread would block, a task's step returns
+   instead, leaving the task parked on a ktask_sema or a timeout,
+   and the worker goes on with other tasks.  Waking the task puts
+   it back on the pool's ready list, where the next free worker
+   picks it up.  A step that runs long should ktask_yield() to
+   let the other tasks of its pool have the worker.
+
+   Tasks may be woken from interrupt handlers and softirqs, so
+   the ready lists and semaphores are protected by disabling
+   interrupts, as in threads/workqueue.c. */
+
+/* A pool of worker threads and the tasks they run. */
+struct ktask_pool
+  {
+    char name[16];              /* Name, for statistics. */
+    int workers;                /* Number of workers. */
+    struct list ready;          /* Tasks with a step to run. */
+    struct semaphore ready_cnt; /* Upped once per ready task. */
+    int live;                   /* Spawned tasks not yet done. */
+    struct list waiters;        /* Threads in ktask_pool_wait(). */
+    struct list_elem elem;      /* Element in all_pools. */
+
+    /* Statistics. */
+    unsigned long spawned;      /* Tasks spawned. */
+    unsigned long finished;     /* Tasks done. */
+    unsigned long steps;        /* Steps run. */
+    unsigned long blocks;       /* Times a task was parked. */
+    int max_live;               /* Most tasks live at once. */
+  };
+
+/* A thread in ktask_pool_wait(). */
+struct pool_waiter
+  {
+    struct semaphore done;      /* Upped when the pool is idle. */
+    struct list_elem elem;      /* Element in the pool's waiters. */
+  };
+
+/* All pools, for statistics. */
+static struct list all_pools = LIST_INITIALIZER (all_pools);
+
+static thread_func worker NO_RETURN;
+
+/* Creates a task pool named NAME whose tasks run on WORKERS
+   threads.  Returns the pool, or a null pointer if memory is
+   short.  Must be called after thread_start(). */
+struct ktask_pool *
+ktask_pool_create (const char *name, int workers)
+{
+  struct ktask_pool *pool;
+  char thread_name[16];
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (workers > 0);
+
+  pool = calloc (1, sizeof *pool);
+  if (pool == NULL)
+    return NULL;
+  strlcpy (pool->name, name, sizeof pool->name);
+  pool->workers = workers;
+  list_init (&pool->ready);
+  sema_init (&pool->ready_cnt, 0);
+  list_init (&pool->waiters);
+
+  /* Pools are never destroyed, so workers run forever. */
+  for (i = 0; i < workers; i++)
+    {
+      snprintf (thread_name, sizeof thread_name, "ktask/%s", name);
+      if (thread_create (thread_name, PRI_DEFAULT, worker, pool)
+          == TID_ERROR)
+        {
+          if (i == 0)
+            {
+              free (pool);
+              return NULL;
+            }
+          pool->workers = i;
+          break;
+        }
+    }
+
+  old_level = intr_disable ();
+  list_push_back (&all_pools, &pool->elem);
+  intr_set_level (old_level);
+  return pool;
+}
+
+/* Initializes T to run FUNC as its first step.  The steps may
+   find AUX in T. */
+void
+ktask_init (struct ktask *t, ktask_func *func, void *aux)
+{
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  t->func = func;
+  t->aux = aux;
+  t->pool = NULL;
+}
+
+/* Appends T to its pool's ready list.  Interrupts must be off. */
+static void
+make_ready (struct ktask *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&t->pool->ready, &t->elem);
+  sema_up (&t->pool->ready_cnt);
+}
+
+/* Starts task T on POOL.
+
+   This function may be called from an interrupt handler. */
+void
+ktask_spawn (struct ktask_pool *pool, struct ktask *t)
+{
+  enum intr_level old_level;
+
+  ASSERT (pool != NULL);
+  ASSERT (t != NULL);
+
+  old_level = intr_disable ();
+  t->pool = pool;
+  pool->spawned++;
+  if (++pool->live > pool->max_live)
+    pool->max_live = pool->live;
+  make_ready (t);
+  intr_set_level (old_level);
+}
+
+/* Lets T's pool run other tasks, then runs NEXT.  A step ends
+   with "return ktask_yield (t, next);". */
+enum ktask_status
+ktask_yield (struct ktask *t, ktask_func *next)
+{
+  ASSERT (next != NULL);
+
+  t->func = next;
+  return KTASK_READY;
+}
+
+/* Timeout function that wakes the sleeping task T_. */
+static void
+sleep_done (void *t_)
+{
+  struct ktask *t = t_;
+
+  make_ready (t);
+}
+
+/* Parks T for TICKS timer ticks, then runs NEXT.  A step ends
+   with "return ktask_sleep (t, ticks, next);". */
+enum ktask_status
+ktask_sleep (struct ktask *t, int64_t ticks, ktask_func *next)
+{
+  enum intr_level old_level;
+
+  ASSERT (next != NULL);
+
+  t->func = next;
+  if (ticks <= 0)
+    return KTASK_READY;
+
+  old_level = intr_disable ();
+  t->pool->blocks++;
+  intr_set_level (old_level);
+  timer_timeout_add (&t->timeout, timer_ticks () + ticks, sleep_done, t);
+  return KTASK_BLOCKED;
+}
+
+/* Initializes S to VALUE. */
+void
+ktask_sema_init (struct ktask_sema *s, unsigned value)
+{
+  ASSERT (s != NULL);
+
+  s->value = value;
+  list_init (&s->waiters);
+}
+
+/* Runs NEXT once T has downed S, parking T until S is positive.
+   A step ends with "return ktask_sema_down (t, s, next);". */
+enum ktask_status
+ktask_sema_down (struct ktask *t, struct ktask_sema *s, ktask_func *next)
+{
+  enum intr_level old_level;
+  enum ktask_status status;
+
+  ASSERT (s != NULL);
+  ASSERT (next != NULL);
+
+  old_level = intr_disable ();
+  t->func = next;
+  if (s->value > 0)
+    {
+      s->value--;
+      status = KTASK_READY;
+    }
+  else
+    {
+      list_push_back (&s->waiters, &t->elem);
+      t->pool->blocks++;
+      status = KTASK_BLOCKED;
+    }
+  intr_set_level (old_level);
+  return status;
+}
+
+/* Ups S, handing it to the first task waiting on it, if any.
+
+   This function may be called from an interrupt handler. */
+void
+ktask_sema_up (struct ktask_sema *s)
+{
+  enum intr_level old_level;
+
+  ASSERT (s != NULL);
+
+  old_level = intr_disable ();
+  if (!list_empty (&s->waiters))
+    make_ready (list_entry (list_pop_front (&s->waiters),
+                            struct ktask, elem));
+  else
+    s->value++;
+  intr_set_level (old_level);
+}
+
+/* Waits until every task spawned on POOL is done.  Tasks parked
+   forever are waited for forever.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+ktask_pool_wait (struct ktask_pool *pool)
+{
+  struct pool_waiter w;
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  if (pool->live > 0)
+    {
+      sema_init (&w.done, 0);
+      list_push_back (&pool->waiters, &w.elem);
+      sema_down (&w.done);
+    }
+  intr_set_level (old_level);
+}
+
+/* A worker thread of task pool POOL_. */
+static void
+worker (void *pool_)
+{
+  struct ktask_pool *pool = pool_;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      enum ktask_status status;
+      struct ktask *t;
+
+      sema_down (&pool->ready_cnt);
+
+      old_level = intr_disable ();
+      ASSERT (!list_empty (&pool->ready));
+      t = list_entry (list_pop_front (&pool->ready), struct ktask, elem);
+      pool->steps++;
+      intr_set_level (old_level);
+
+      /* Unless the step returns KTASK_READY, T may be freed, or
+         woken and run by another worker, from here on. */
+      status = t->func (t);
+
+      old_level = intr_disable ();
+      if (status == KTASK_READY)
+        make_ready (t);
+      else if (status == KTASK_DONE)
+        {
+          pool->live--;
+          pool->finished++;
+          if (pool->live == 0)
+            while (!list_empty (&pool->waiters))
+              sema_up (&list_entry (list_pop_front (&pool->waiters),
+                                    struct pool_waiter, elem)->done);
+        }
+      intr_set_level (old_level);
+    }
+}
+
+/* Prints statistics for every task pool. */
+void
+ktask_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_pools); e != list_end (&all_pools);
+       e = list_next (e))
+    {
+      struct ktask_pool *pool = list_entry (e, struct ktask_pool, elem);
+
+      printf ("Task pool %s: %d workers, %lu spawned, %lu done, "
+              "%lu steps, %lu blocks, max %d live\n",
+              pool->name, pool->workers, pool->spawned, pool->finished,
+              pool->steps, pool->blocks, pool->max_live);
+    }
+}
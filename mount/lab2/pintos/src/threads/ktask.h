@@ -0,0 +1,65 @@
+#ifndef THREADS_KTASK_H
+#define THREADS_KTASK_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+struct ktask;
+struct ktask_pool;
+
+/* What a task's step returns. */
+enum ktask_status
+  {
+    KTASK_DONE,                 /* Finished; the pool forgets it. */
+    KTASK_READY,                /* Run the next step when its turn comes. */
+    KTASK_BLOCKED               /* Parked until something wakes it. */
+  };
+
+/* Runs one step of task T.  A step must not sleep.  It returns
+   KTASK_DONE when the task is finished, which T may also free,
+   or else the result of ktask_yield(), ktask_sema_down() or
+   ktask_sleep(), which set the step to run next. */
+typedef enum ktask_status ktask_func (struct ktask *t);
+
+/* A lightweight task.  Embed it in the structure that holds the
+   task's state and recover that with list_entry()-style
+   arithmetic, or use AUX. */
+struct ktask
+  {
+    ktask_func *func;           /* Next step. */
+    void *aux;                  /* For the steps' use. */
+
+    /* Owned by ktask.c. */
+    struct ktask_pool *pool;    /* Pool it runs on. */
+    struct list_elem elem;      /* Ready list or semaphore waiters. */
+    struct timer_timeout timeout; /* Ends ktask_sleep(). */
+  };
+
+/* A counting semaphore that tasks wait on without blocking their
+   worker. */
+struct ktask_sema
+  {
+    unsigned value;             /* Current value. */
+    struct list waiters;        /* Waiting tasks. */
+  };
+
+struct ktask_pool *ktask_pool_create (const char *name, int workers);
+void ktask_pool_wait (struct ktask_pool *);
+
+void ktask_init (struct ktask *, ktask_func *, void *aux);
+void ktask_spawn (struct ktask_pool *, struct ktask *);
+
+enum ktask_status ktask_yield (struct ktask *, ktask_func *next);
+enum ktask_status ktask_sleep (struct ktask *, int64_t ticks,
+                               ktask_func *next);
+
+void ktask_sema_init (struct ktask_sema *, unsigned value);
+enum ktask_status ktask_sema_down (struct ktask *, struct ktask_sema *,
+                                   ktask_func *next);
+void ktask_sema_up (struct ktask_sema *);
+
+void ktask_print_stats (void);
+
+#endif /* threads/ktask.h */
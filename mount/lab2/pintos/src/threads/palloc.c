@@ -36,6 +36,12 @@ struct pool
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Registered shrinkers, in priority order.  shrink_lock keeps
+   two failed allocations from shrinking at once, and a shrinker
+   that allocates from shrinking recursively. */
+static struct list shrinkers;
+static struct lock shrink_lock;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
@@ -59,6 +65,58 @@ palloc_init (size_t user_page_limit)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+
+  list_init (&shrinkers);
+  lock_init (&shrink_lock);
+}
+
+/* Returns true if shrinker A is asked before B. */
+static bool
+shrinker_less (const struct list_elem *a_, const struct list_elem *b_,
+               void *aux UNUSED)
+{
+  const struct shrinker *a = list_entry (a_, struct shrinker, elem);
+  const struct shrinker *b = list_entry (b_, struct shrinker, elem);
+  return a->priority < b->priority;
+}
+
+/* Registers shrinker S.  Only to be called during boot. */
+void
+palloc_register_shrinker (struct shrinker *s)
+{
+  s->calls = 0;
+  s->reclaimed = 0;
+  list_insert_ordered (&shrinkers, &s->elem, shrinker_less, NULL);
+}
+
+/* Asks the shrinkers of POOL to free PAGE_CNT pages between
+   them.  Returns true if any pages were freed. */
+static bool
+shrink (const struct pool *pool, size_t page_cnt)
+{
+  struct list_elem *e;
+  size_t freed = 0;
+
+  if (lock_held_by_current_thread (&shrink_lock)
+      || !lock_try_acquire (&shrink_lock))
+    return false;
+  for (e = list_begin (&shrinkers);
+       e != list_end (&shrinkers) && freed < page_cnt; e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      size_t cnt;
+
+      if (s->user != (pool == &user_pool) || (cnt = s->count ()) == 0)
+        continue;
+      if (cnt > page_cnt - freed)
+        cnt = page_cnt - freed;
+      cnt = s->scan (cnt);
+      s->calls++;
+      s->reclaimed += cnt;
+      freed += cnt;
+    }
+  lock_release (&shrink_lock);
+  return freed > 0;
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -81,6 +139,14 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
   lock_release (&pool->lock);
 
+  /* Out of pages: have the caches give some back and retry. */
+  if (page_idx == BITMAP_ERROR && shrink (pool, page_cnt))
+    {
+      lock_acquire (&pool->lock);
+      page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+      lock_release (&pool->lock);
+    }
+
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
   else
@@ -148,6 +214,21 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Prints shrinker statistics. */
+void
+palloc_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      printf ("Shrinker %s: %lu calls, %lu pages reclaimed\n",
+              s->name, s->calls, s->reclaimed);
+    }
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
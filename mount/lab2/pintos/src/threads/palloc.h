@@ -1,6 +1,8 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <list.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,10 +13,35 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* A cache that can give pages back when a pool runs dry.  When
+   an allocation from its pool fails, palloc asks the registered
+   shrinkers, in priority order, to free pages, and retries.
+
+   SCAN runs inside the failed allocation, whose caller may hold
+   any lock, including the shrinker's own, so it must not wait
+   for locks: it should free nothing if lock_held_by_current_thread()
+   is true or lock_try_acquire() fails. */
+struct shrinker
+  {
+    const char *name;                   /* For statistics. */
+    int priority;                       /* Lower ones are asked first. */
+    bool user;                          /* Caches user pool pages? */
+    size_t (*count) (void);             /* Pages it could free. */
+    size_t (*scan) (size_t page_cnt);   /* Frees up to PAGE_CNT pages,
+                                           returns how many it did. */
+
+    /* Owned by palloc.c. */
+    unsigned long calls;                /* Times asked to free pages. */
+    unsigned long reclaimed;            /* Pages it freed. */
+    struct list_elem elem;              /* Element in shrinker list. */
+  };
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_register_shrinker (struct shrinker *);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,271 @@
+#include "threads/softirq.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Deferred interrupt work.
+
+   An external interrupt handler runs with interrupts off, so the
+   longer it takes, the longer other interrupts wait, and a timer
+   tick or keystroke that arrives twice meanwhile is lost.  So a
+   handler does only what cannot wait (acknowledging the device,
+   reading a status register) and raises a softirq for the rest.
+
+   Raised softirqs run as an external interrupt returns, from
+   intr_handler(), once the PIC has been acknowledged and with
+   interrupts back on.  An interrupt that arrives meanwhile runs
+   its top half and raises its softirqs as usual, and the run it
+   interrupted picks them up.  A run stops after MAX_ROUNDS
+   rounds, so a steady stream of interrupts cannot starve the
+   interrupted thread, and leaves the rest to the ksoftirqd
+   thread, which the scheduler runs like any other.
+
+   Softirqs run on the stack of whatever thread was interrupted
+   and must not sleep.  Tasklets, functions a handler schedules
+   to run under SOFTIRQ_TASKLET, are the way for drivers to use
+   the mechanism without a source of their own. */
+
+/* Most rounds of raised softirqs handled per run. */
+#define MAX_ROUNDS 10
+
+/* A source of deferred work. */
+struct source
+  {
+    softirq_func *func;         /* Runs its work. */
+    const char *name;           /* Name, for statistics. */
+    unsigned long raised;       /* Times raised. */
+    unsigned long runs;         /* Times FUNC was called. */
+  };
+
+static softirq_func run_tasklets;
+
+/* The tasklet source is built in; others register. */
+static struct source sources[SOFTIRQ_CNT] =
+  {
+    [SOFTIRQ_TASKLET] = {run_tasklets, "tasklet", 0, 0},
+  };
+
+/* Raised sources, one bit per source.  Interrupts must be off
+   to touch this. */
+static unsigned pending;
+
+/* Running softirqs now? */
+static bool active;
+
+/* Runs softirqs left over by a run that gave up. */
+static struct thread *ksoftirqd;
+static unsigned long deferred;  /* Times it was woken. */
+
+/* Scheduled tasklets.  Interrupts must be off to touch this. */
+static struct list tasklets = LIST_INITIALIZER (tasklets);
+static unsigned long tasklets_scheduled;
+static unsigned long tasklets_run;
+
+static thread_func ksoftirqd_loop NO_RETURN;
+
+/* Registers FUNC, named NAME, to run the work of source NR. */
+void
+softirq_register (enum softirq nr, softirq_func *func, const char *name)
+{
+  ASSERT (nr < SOFTIRQ_CNT);
+  ASSERT (sources[nr].func == NULL);
+
+  sources[nr].func = func;
+  sources[nr].name = name;
+}
+
+/* Wakes ksoftirqd, if it exists and sleeps.  Interrupts must be
+   off. */
+static void
+wake_ksoftirqd (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (ksoftirqd != NULL && ksoftirqd->status == THREAD_BLOCKED)
+    {
+      deferred++;
+      thread_unblock (ksoftirqd);
+    }
+}
+
+/* Marks source NR as having work to do.  From an interrupt
+   handler, the work runs as the interrupt returns; otherwise
+   ksoftirqd runs it. */
+void
+softirq_raise (enum softirq nr)
+{
+  enum intr_level old_level;
+
+  ASSERT (nr < SOFTIRQ_CNT);
+  ASSERT (sources[nr].func != NULL);
+
+  old_level = intr_disable ();
+  pending |= 1u << nr;
+  sources[nr].raised++;
+  if (!intr_context () && !active)
+    wake_ksoftirqd ();
+  intr_set_level (old_level);
+}
+
+/* Runs raised softirqs, with interrupts on, for up to
+   MAX_ROUNDS rounds.  Interrupts must be off, and are off again
+   on return. */
+static void
+run_pending (void)
+{
+  int round;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!active);
+
+  active = true;
+  for (round = 0; pending != 0 && round < MAX_ROUNDS; round++)
+    {
+      unsigned mask = pending;
+      int nr;
+
+      pending = 0;
+      intr_enable ();
+      for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+        if (mask & (1u << nr))
+          {
+            sources[nr].runs++;
+            sources[nr].func ();
+          }
+      intr_disable ();
+    }
+  active = false;
+}
+
+/* Runs raised softirqs.  Called by intr_handler() as an external
+   interrupt returns, with interrupts off.  Does nothing if the
+   interrupt arrived while softirqs were running. */
+void
+softirq_run (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!intr_context ());
+
+  if (pending == 0 || active)
+    return;
+  run_pending ();
+  if (pending != 0)
+    wake_ksoftirqd ();
+}
+
+/* Creates ksoftirqd.  Must be called after thread_start(). */
+void
+softirq_start (void)
+{
+  if (thread_create ("ksoftirqd", PRI_DEFAULT, ksoftirqd_loop, NULL)
+      == TID_ERROR)
+    PANIC ("cannot create ksoftirqd");
+}
+
+/* Returns true while softirqs are running, when sleeping is not
+   allowed. */
+bool
+softirq_context (void)
+{
+  return active;
+}
+
+/* Runs softirqs that an interrupted run left over or that were
+   raised outside an interrupt handler. */
+static void
+ksoftirqd_loop (void *aux UNUSED)
+{
+  intr_disable ();
+  ksoftirqd = thread_current ();
+  for (;;)
+    {
+      while (pending == 0)
+        thread_block ();
+      run_pending ();
+
+      /* While softirqs run, intr_handler() neither runs them nor
+         ends our time slice, so let other threads in before a
+         run that MAX_ROUNDS cut short goes on. */
+      if (pending != 0)
+        {
+          intr_enable ();
+          thread_yield ();
+          intr_disable ();
+        }
+    }
+}
+
+/* Initializes T to run FUNC, which may find AUX in T. */
+void
+tasklet_init (struct tasklet *t, tasklet_func *func, void *aux)
+{
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  t->func = func;
+  t->aux = aux;
+  t->scheduled = false;
+}
+
+/* Schedules T to run with interrupts on.  Scheduling it again
+   before it starts does nothing, but it may be scheduled again
+   once it has started, even by itself. */
+void
+tasklet_schedule (struct tasklet *t)
+{
+  enum intr_level old_level;
+
+  ASSERT (t != NULL);
+
+  old_level = intr_disable ();
+  if (!t->scheduled)
+    {
+      t->scheduled = true;
+      list_push_back (&tasklets, &t->elem);
+      tasklets_scheduled++;
+      softirq_raise (SOFTIRQ_TASKLET);
+    }
+  intr_set_level (old_level);
+}
+
+/* Runs the tasklets scheduled so far.  Those scheduled while they
+   run wait for the next round. */
+static void
+run_tasklets (void)
+{
+  struct list batch;
+
+  intr_disable ();
+  list_init (&batch);
+  while (!list_empty (&tasklets))
+    list_push_back (&batch, list_pop_front (&tasklets));
+  intr_enable ();
+
+  while (!list_empty (&batch))
+    {
+      struct tasklet *t = list_entry (list_pop_front (&batch),
+                                      struct tasklet, elem);
+
+      intr_disable ();
+      t->scheduled = false;
+      tasklets_run++;
+      intr_enable ();
+      t->func (t);
+    }
+}
+
+/* Prints softirq statistics. */
+void
+softirq_print_stats (void)
+{
+  int nr;
+
+  for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+    if (sources[nr].func != NULL)
+      printf ("Softirq %s: %lu raised, %lu runs\n",
+              sources[nr].name, sources[nr].raised, sources[nr].runs);
+  printf ("Softirqs: %lu tasklets scheduled, %lu run, "
+          "%lu handed to ksoftirqd\n",
+          tasklets_scheduled, tasklets_run, deferred);
+}
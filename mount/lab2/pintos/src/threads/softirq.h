@@ -0,0 +1,47 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Sources of deferred interrupt work, in the order they run. */
+enum softirq
+  {
+    SOFTIRQ_TIMER,              /* Expired timeouts. */
+    SOFTIRQ_TASKLET,            /* Scheduled tasklets. */
+    SOFTIRQ_CNT                 /* Number of sources. */
+  };
+
+/* Runs the deferred work of one source.  Called with interrupts
+   on; must not sleep. */
+typedef void softirq_func (void);
+
+void softirq_register (enum softirq, softirq_func *, const char *name);
+void softirq_raise (enum softirq);
+void softirq_run (void);
+void softirq_start (void);
+bool softirq_context (void);
+
+struct tasklet;
+
+/* Runs tasklet T. */
+typedef void tasklet_func (struct tasklet *t);
+
+/* A tasklet: a function that an interrupt handler schedules to
+   run soon after it returns, with interrupts on. */
+struct tasklet
+  {
+    tasklet_func *func;         /* Function to run. */
+    void *aux;                  /* For FUNC's use. */
+
+    /* Owned by softirq.c. */
+    bool scheduled;             /* On the tasklet list? */
+    struct list_elem elem;      /* Element in the tasklet list. */
+  };
+
+void tasklet_init (struct tasklet *, tasklet_func *, void *aux);
+void tasklet_schedule (struct tasklet *);
+
+void softirq_print_stats (void);
+
+#endif /* threads/softirq.h */
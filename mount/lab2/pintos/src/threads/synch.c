@@ -29,6 +29,7 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
@@ -101,6 +102,60 @@ sema_try_down (struct semaphore *sema)
   return success;
 }
 
+/* Timeout function for sema_down_timeout().  Takes thread T_
+   off the waiters list of the semaphore it sleeps on, unless
+   sema_up() already did, and wakes it. */
+static void
+sema_timeout (void *t_)
+{
+  struct thread *t = t_;
+
+  if (t->status == THREAD_BLOCKED)
+    {
+      list_remove (&t->elem);
+      thread_unblock (t);
+    }
+}
+
+/* Down or "P" operation on a semaphore, but giving up at timer
+   tick DEADLINE, a value on the timer_ticks() scale.  Returns
+   true if SEMA was decremented, false if the deadline came
+   first.  The timer softirq, with interrupts off, wakes the
+   thread at the deadline, so it does not poll.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t deadline)
+{
+  struct timer_timeout timeout;
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  if (sema->value == 0 && timer_ticks () < deadline)
+    {
+      /* We block only in this loop, so while the timeout is
+         pending, a blocked thread is waiting on SEMA. */
+      timer_timeout_add (&timeout, deadline, sema_timeout, thread_current ());
+      while (sema->value == 0 && timeout.pending)
+        {
+          list_push_back (&sema->waiters, &thread_current ()->elem);
+          thread_block ();
+        }
+      timer_timeout_cancel (&timeout);
+    }
+  success = sema->value > 0;
+  if (success)
+    sema->value--;
+  intr_set_level (old_level);
+
+  return success;
+}
+
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
 
@@ -220,6 +275,25 @@ lock_try_acquire (struct lock *lock)
   return success;
 }
 
+/* Acquires LOCK like lock_acquire(), but gives up at timer tick
+   DEADLINE.  Returns true if LOCK was acquired, false if the
+   deadline came first.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t deadline)
+{
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!lock_held_by_current_thread (lock));
+
+  if (!sema_down_timeout (&lock->semaphore, deadline))
+    return false;
+  lock->holder = thread_current ();
+  return true;
+}
+
 /* Releases LOCK, which must be owned by the current thread.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -301,6 +375,41 @@ cond_wait (struct condition *cond, struct lock *lock)
   lock_acquire (lock);
 }
 
+/* Like cond_wait(), but stops waiting for COND at timer tick
+   DEADLINE.  LOCK is reacquired before returning either way.
+   Returns true if COND was signaled, false if the deadline came
+   first.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+cond_wait_timeout (struct condition *cond, struct lock *lock,
+                   int64_t deadline)
+{
+  struct semaphore_elem waiter;
+  bool signaled;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  sema_init (&waiter.semaphore, 0);
+  list_push_back (&cond->waiters, &waiter.elem);
+  lock_release (lock);
+  signaled = sema_down_timeout (&waiter.semaphore, deadline);
+  lock_acquire (lock);
+  if (!signaled)
+    {
+      /* A signal may have come between the deadline and
+         reacquiring LOCK.  If not, we are still on the list. */
+      signaled = sema_try_down (&waiter.semaphore);
+      if (!signaled)
+        list_remove (&waiter.elem);
+    }
+  return signaled;
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -336,3 +445,162 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as a readers-writer lock.  Any number of
+   readers may hold it at once, or a single writer.
+
+   Writers are preferred: once a writer is waiting, new readers
+   wait until it is done, so a steady stream of readers cannot
+   starve writers.  A reader may upgrade its hold to a write hold
+   and a writer may downgrade to a read hold without letting
+   anyone else in between.
+
+   Neither mode is recursive.  In particular, a reader that tries
+   to read again while a writer is waiting deadlocks. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  cond_init (&rw->read_ok);
+  cond_init (&rw->write_ok);
+  cond_init (&rw->upgrade_ok);
+  rw->readers = 0;
+  rw->waiting_writers = 0;
+  rw->upgrading = false;
+  rw->writer = NULL;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rw->writer != thread_current ());
+
+  lock_acquire (&rw->lock);
+  while (rw->writer != NULL || rw->waiting_writers > 0 || rw->upgrading)
+    cond_wait (&rw->read_ok, &rw->lock);
+  rw->readers++;
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  rw->readers--;
+  if (rw->upgrading && rw->readers == 1)
+    cond_signal (&rw->upgrade_ok, &rw->lock);
+  else if (rw->readers == 0)
+    cond_signal (&rw->write_ok, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no reader or other
+   writer holds it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rw->writer != thread_current ());
+
+  lock_acquire (&rw->lock);
+  rw->waiting_writers++;
+  while (rw->writer != NULL || rw->readers > 0)
+    cond_wait (&rw->write_ok, &rw->lock);
+  rw->waiting_writers--;
+  rw->writer = thread_current ();
+  lock_release (&rw->lock);
+}
+
+/* Wakes whoever may have RW next after a writer leaves: another
+   writer if one is waiting, otherwise all waiting readers.
+   RW's lock must be held. */
+static void
+rwlock_wake (struct rwlock *rw)
+{
+  if (rw->waiting_writers > 0)
+    cond_signal (&rw->write_ok, &rw->lock);
+  else
+    cond_broadcast (&rw->read_ok, &rw->lock);
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rwlock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  rw->writer = NULL;
+  rwlock_wake (rw);
+  lock_release (&rw->lock);
+}
+
+/* Turns the current thread's read hold on RW into a write hold,
+   sleeping until the other readers are gone.  New readers and
+   writers wait meanwhile.
+
+   Only one reader can upgrade at a time.  If another reader is
+   already upgrading, returns false with RW still held for
+   reading; the caller must then release it, to let the other
+   upgrade finish, and acquire RW for writing from scratch. */
+bool
+rwlock_upgrade (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  if (rw->upgrading)
+    {
+      lock_release (&rw->lock);
+      return false;
+    }
+  rw->upgrading = true;
+  while (rw->readers > 1)
+    cond_wait (&rw->upgrade_ok, &rw->lock);
+  rw->upgrading = false;
+  rw->readers = 0;
+  rw->writer = thread_current ();
+  lock_release (&rw->lock);
+  return true;
+}
+
+/* Turns the current thread's write hold on RW into a read hold.
+   Waiting readers get in too, unless a writer is waiting. */
+void
+rwlock_downgrade (struct rwlock *rw)
+{
+  ASSERT (rwlock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  rw->writer = NULL;
+  rw->readers = 1;
+  if (rw->waiting_writers == 0)
+    cond_broadcast (&rw->read_ok, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing.
+   There is no such test for readers, who are not tracked. */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
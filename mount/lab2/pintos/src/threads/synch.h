@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -14,6 +15,7 @@ struct semaphore
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t deadline);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
@@ -27,6 +29,7 @@ struct lock
 void lock_init (struct lock *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
+bool lock_acquire_timeout (struct lock *, int64_t deadline);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
@@ -38,9 +41,32 @@ struct condition
 
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
+bool cond_wait_timeout (struct condition *, struct lock *, int64_t deadline);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition read_ok;   /* Readers wait here. */
+    struct condition write_ok;  /* Writers wait here. */
+    struct condition upgrade_ok; /* An upgrading reader waits here. */
+    int readers;                /* Number of readers holding it. */
+    int waiting_writers;        /* Number of writers waiting. */
+    bool upgrading;             /* A reader waiting to upgrade? */
+    struct thread *writer;      /* Writer holding it, or null. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_upgrade (struct rwlock *);
+void rwlock_downgrade (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
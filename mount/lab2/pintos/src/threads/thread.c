@@ -8,6 +8,7 @@
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/softirq.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -49,6 +50,21 @@ struct kernel_thread_frame
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long pages_reused;  /* # of thread pages taken from the cache. */
+static long long pages_fresh;   /* # of thread pages from palloc. */
+static long long pages_freed;   /* # of thread pages returned to palloc. */
+
+/* Pages of dead threads.  Up to PAGE_CACHE_MAX are kept for
+   thread_create() to reuse, so that creating a thread does not
+   usually have to go to the page allocator; the rest wait in
+   dead_pages for reap_dead_pages().  Interrupts must be off to
+   touch these lists.  The cache gives its pages back when the
+   kernel pool runs short. */
+#define PAGE_CACHE_MAX 16
+static struct list page_cache;  /* Pages ready for reuse. */
+static size_t page_cache_cnt;   /* Number of pages in page_cache. */
+static struct list dead_pages;  /* Pages to return to palloc. */
+static struct shrinker page_cache_shrinker;
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
@@ -70,6 +86,8 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *get_thread_page (void);
+static void reap_dead_pages (void);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -92,6 +110,8 @@ thread_init (void)
   lock_init (&tid_lock);
   list_init (&ready_list);
   list_init (&all_list);
+  list_init (&page_cache);
+  list_init (&dead_pages);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -107,6 +127,7 @@ thread_start (void)
 {
   /* Create the idle thread. */
   struct semaphore idle_started;
+  palloc_register_shrinker (&page_cache_shrinker);
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
@@ -129,13 +150,19 @@ thread_tick (void)
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    {
+      user_ticks++;
+#ifdef VM
+      t->leader->vm_vtime++;
+#endif
+    }
 #endif
   else
     kernel_ticks++;
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  /* Enforce preemption, unless the thread has disabled it, in
+     which case preempt_enable() yields. */
+  if (++thread_ticks >= TIME_SLICE && t->preempt_count == 0)
     intr_yield_on_return ();
 }
 
@@ -145,6 +172,8 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread pages: %lld reused, %lld allocated, %lld freed\n",
+          pages_reused, pages_fresh, pages_freed);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -175,8 +204,9 @@ thread_create (const char *name, int priority,
 
   ASSERT (function != NULL);
 
-  /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  /* Allocate thread.  init_thread() clears the struct thread,
+     and the stack needs no clearing. */
+  t = get_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -221,7 +251,9 @@ void
 thread_block (void) 
 {
   ASSERT (!intr_context ());
+  ASSERT (!softirq_context ());
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (thread_current ()->preempt_count == 0);
 
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
@@ -292,6 +324,7 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  reap_dead_pages ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -312,6 +345,7 @@ thread_yield (void)
   enum intr_level old_level;
   
   ASSERT (!intr_context ());
+  ASSERT (cur->preempt_count == 0);
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
@@ -321,6 +355,34 @@ thread_yield (void)
   intr_set_level (old_level);
 }
 
+/* Keeps the current thread from being preempted, until a
+   matching call to preempt_enable(), while leaving interrupts
+   on.  This is enough to protect data that only threads touch;
+   data that interrupt handlers touch still needs interrupts off.
+   Calls nest.  The thread must not sleep or yield meanwhile. */
+void
+preempt_disable (void) 
+{
+  thread_current ()->preempt_count++;
+  barrier ();
+}
+
+/* Undoes one preempt_disable().  When the last is undone, yields
+   if the thread's time slice ran out meanwhile. */
+void
+preempt_enable (void) 
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (cur->preempt_count > 0);
+
+  barrier ();
+  if (--cur->preempt_count == 0 && thread_ticks >= TIME_SLICE
+      && !intr_context () && !softirq_context ()
+      && intr_get_level () == INTR_ON)
+    thread_yield ();
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -469,7 +531,14 @@ init_thread (struct thread *t, const char *name, int priority)
   t->priority = priority;
   t->magic = THREAD_MAGIC;
   list_push_back (&all_list, &t->allelem);
-  t->alarm_tick = -1;
+#ifdef USERPROG
+  t->leader = t;
+  t->exit_status = -1;
+  list_init (&t->children);
+  list_init (&t->files);
+  t->next_fd = 2;
+  list_init (&t->mappings);
+#endif
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -537,14 +606,125 @@ thread_schedule_tail (struct thread *prev)
      thread.  This must happen late so that thread_exit() doesn't
      pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
-     palloc().) */
+     palloc().)  Its page goes to the cache, or else waits for
+     reap_dead_pages(), since palloc_free_page() takes a lock,
+     which we cannot do here. */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      if (page_cache_cnt < PAGE_CACHE_MAX)
+        {
+          list_push_front (&page_cache, &prev->elem);
+          page_cache_cnt++;
+        }
+      else
+        list_push_back (&dead_pages, &prev->elem);
     }
 }
 
+/* Returns a page for a new thread, from the cache if it has one
+   and otherwise from the page allocator, or a null pointer if
+   memory is short.  The page's contents are garbage. */
+static struct thread *
+get_thread_page (void) 
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  reap_dead_pages ();
+
+  old_level = intr_disable ();
+  if (!list_empty (&page_cache))
+    {
+      t = list_entry (list_pop_front (&page_cache), struct thread, elem);
+      page_cache_cnt--;
+      pages_reused++;
+    }
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    {
+      t = palloc_get_page (0);
+      if (t != NULL)
+        {
+          preempt_disable ();
+          pages_fresh++;
+          preempt_enable ();
+        }
+    }
+  return t;
+}
+
+/* Returns the pages of dead threads that did not fit in the
+   cache to the page allocator. */
+static void
+reap_dead_pages (void) 
+{
+  struct list dead;
+  enum intr_level old_level;
+
+  list_init (&dead);
+  old_level = intr_disable ();
+  while (!list_empty (&dead_pages))
+    list_push_back (&dead, list_pop_front (&dead_pages));
+  intr_set_level (old_level);
+
+  while (!list_empty (&dead))
+    {
+      palloc_free_page (list_entry (list_pop_front (&dead),
+                                    struct thread, elem));
+      preempt_disable ();
+      pages_freed++;
+      preempt_enable ();
+    }
+}
+
+/* Returns the number of pages in the thread page cache. */
+static size_t
+page_cache_count (void)
+{
+  return page_cache_cnt;
+}
+
+/* Frees up to PAGE_CNT pages of the thread page cache, for a
+   page allocation that failed.  Returns the number freed. */
+static size_t
+page_cache_scan (size_t page_cnt)
+{
+  struct list pages;
+  enum intr_level old_level;
+  size_t freed = 0;
+
+  list_init (&pages);
+  old_level = intr_disable ();
+  while (freed < page_cnt && !list_empty (&page_cache))
+    {
+      list_push_back (&pages, list_pop_front (&page_cache));
+      page_cache_cnt--;
+      freed++;
+    }
+  intr_set_level (old_level);
+
+  while (!list_empty (&pages))
+    palloc_free_page (list_entry (list_pop_front (&pages),
+                                  struct thread, elem));
+  preempt_disable ();
+  pages_freed += freed;
+  preempt_enable ();
+  return freed;
+}
+
+/* Hands cached thread pages back before other caches, since a
+   new thread page costs no more than a palloc_get_page(). */
+static struct shrinker page_cache_shrinker =
+  {
+    .name = "thread",
+    .priority = 0,
+    .user = false,
+    .count = page_cache_count,
+    .scan = page_cache_scan,
+  };
+
 /* Schedules a new process.  At entry, interrupts must be off and
    the running process's state must have been changed from
    running to some other state.  This function finds another
@@ -4,6 +4,14 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#ifdef USERPROG
+#include "userprog/uthread.h"
+#endif
+#ifdef VM
+#include <hash.h>
+#include "threads/synch.h"
+#include "vm/stats.h"
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -89,6 +97,7 @@ struct thread
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
+    int preempt_count;                  /* preempt_disable() depth. */
     struct list_elem allelem;           /* List element for all threads list. */
 
     /* Shared between thread.c and synch.c. */
@@ -97,10 +106,40 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    struct file *exec_file;             /* Leader: executable, kept open. */
+    int exit_status;                    /* Leader: status for the parent. */
+    struct child *child;                /* Leader: record the parent waits on. */
+    struct list children;               /* Processes we started. */
+
+    /* Owned by userprog/syscall.c. */
+    struct list files;                  /* Leader: open files. */
+    int next_fd;                        /* Leader: next file descriptor. */
+    struct list mappings;               /* Leader: mapped files. */
+    int next_mapid;                     /* Leader: next mapping id. */
+
+    /* Owned by userprog/uthread.c. */
+    struct thread *leader;              /* Owns our address space. */
+    struct uthread_group uthreads;      /* Leader: its other threads. */
+    struct uthread *uthread;            /* Others: our join record. */
 #endif
 
-    /* Owned by devices/timer.c */
-    int alarm_tick;                     /* The tick to wake this thread up on */
+#ifdef VM
+    /* Owned by vm/page.c.  Only the leader's pages and pages_lock
+       are used. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct lock pages_lock;             /* Serializes its users. */
+    void *ra_next;                      /* Fault that continues a scan. */
+    int ra_window;                      /* Pages to read ahead. */
+
+    /* Owned by vm/frame.c. */
+    int vm_resident;                    /* Frames holding our pages. */
+
+    /* Owned by thread.c. */
+    int64_t vm_vtime;                   /* Ticks our threads ran. */
+
+    /* Owned by vm/stats.c. */
+    struct vm_stats vm_stats;           /* Paging statistics. */
+#endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -130,6 +169,9 @@ const char *thread_name (void);
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
 
+void preempt_disable (void);
+void preempt_enable (void);
+
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
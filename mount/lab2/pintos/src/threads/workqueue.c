@@ -0,0 +1,342 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Work queues.
+
+   A work queue runs work items, functions to be called later in
+   thread context, on a fixed pool of MAX_ACTIVE kernel threads
+   of its own, so at most that many of its items run at once.
+   Subsystems with background work queue it on system_wq, or on
+   a queue of their own if they need more concurrency or must
+   not wait behind others, instead of each keeping threads of
+   its own.
+
+   Items may be queued from interrupt handlers, and delayed items
+   are queued by the timer's softirq when they come due, so the
+   queues are protected by disabling interrupts, not by locks.
+   An item is pending from when it is queued until a worker
+   starts it; queueing a pending item does nothing, but an item
+   may be queued again once it has started, even by itself. */
+
+/* A queue and its workers. */
+struct workqueue
+  {
+    char name[16];              /* Name, for statistics. */
+    int max_active;             /* Number of workers. */
+    struct list items;          /* Queued work items. */
+    struct semaphore ready;     /* Upped once per queued item. */
+    int active;                 /* Items running now. */
+    struct list flushers;       /* Threads in workqueue_flush(). */
+    struct list_elem elem;      /* Element in all_queues. */
+
+    /* Statistics. */
+    unsigned long queued;       /* Items queued. */
+    unsigned long delayed;      /* Of those, queued after a delay. */
+    unsigned long executed;     /* Items run. */
+    unsigned long cancelled;    /* Items cancelled while pending. */
+    int max_depth;              /* Most items queued at once. */
+    int64_t wait_ticks;         /* Total ticks from queued to started. */
+  };
+
+/* A thread in workqueue_flush(). */
+struct flusher
+  {
+    struct semaphore done;      /* Upped when the queue is idle. */
+    struct list_elem elem;      /* Element in the queue's flushers. */
+  };
+
+struct workqueue *system_wq;
+
+/* All queues, for statistics.  Initialized statically, since
+   a panic early in boot prints statistics. */
+static struct list all_queues = LIST_INITIALIZER (all_queues);
+
+static thread_func worker NO_RETURN;
+
+/* Initializes the work queue system and creates system_wq.
+   Must be called after thread_start(). */
+void
+workqueue_init (void)
+{
+  system_wq = workqueue_create ("system", 2);
+  if (system_wq == NULL)
+    PANIC ("cannot create system work queue");
+}
+
+/* Creates a work queue named NAME whose items run on MAX_ACTIVE
+   worker threads.  Returns the queue, or a null pointer if
+   memory is short. */
+struct workqueue *
+workqueue_create (const char *name, int max_active)
+{
+  struct workqueue *wq;
+  char thread_name[16];
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (max_active > 0);
+
+  wq = calloc (1, sizeof *wq);
+  if (wq == NULL)
+    return NULL;
+  strlcpy (wq->name, name, sizeof wq->name);
+  wq->max_active = max_active;
+  list_init (&wq->items);
+  sema_init (&wq->ready, 0);
+  list_init (&wq->flushers);
+
+  /* Queues are never destroyed, so workers run forever. */
+  for (i = 0; i < max_active; i++)
+    {
+      snprintf (thread_name, sizeof thread_name, "kworker/%s", name);
+      if (thread_create (thread_name, PRI_DEFAULT, worker, wq) == TID_ERROR)
+        {
+          if (i == 0)
+            {
+              free (wq);
+              return NULL;
+            }
+          wq->max_active = i;
+          break;
+        }
+    }
+
+  old_level = intr_disable ();
+  list_push_back (&all_queues, &wq->elem);
+  intr_set_level (old_level);
+  return wq;
+}
+
+/* Initializes W to run FUNC, which may find AUX in W. */
+void
+work_init (struct work *w, work_func *func, void *aux)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->wq = NULL;
+  w->queued = false;
+  w->delayed = false;
+}
+
+/* Appends W to WQ's list.  Interrupts must be off. */
+static void
+enqueue (struct workqueue *wq, struct work *w)
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  w->wq = wq;
+  w->queued = true;
+  w->queue_time = timer_ticks ();
+  list_push_back (&wq->items, &w->elem);
+  wq->queued++;
+  depth = list_size (&wq->items);
+  if (depth > wq->max_depth)
+    wq->max_depth = depth;
+  sema_up (&wq->ready);
+}
+
+/* Queues W on WQ to run as soon as a worker is free.  Returns
+   true if it was queued, false if it was already pending.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  if (!w->queued && !w->delayed)
+    {
+      enqueue (wq, w);
+      queued = true;
+    }
+  intr_set_level (old_level);
+  return queued;
+}
+
+/* Timeout function that queues the delayed work item W_. */
+static void
+delayed_work_due (void *w_)
+{
+  struct work *w = w_;
+
+  w->delayed = false;
+  w->wq->delayed++;
+  enqueue (w->wq, w);
+}
+
+/* Queues W on WQ once TICKS timer ticks have passed.  Returns
+   true if it was queued, false if it was already pending.
+
+   This function may be called from an interrupt handler. */
+bool
+work_queue_delayed (struct workqueue *wq, struct work *w, int64_t ticks)
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  if (ticks <= 0)
+    return work_queue (wq, w);
+
+  old_level = intr_disable ();
+  if (!w->queued && !w->delayed)
+    {
+      w->wq = wq;
+      w->delayed = true;
+      timer_timeout_add (&w->timeout, timer_ticks () + ticks,
+                         delayed_work_due, w);
+      queued = true;
+    }
+  intr_set_level (old_level);
+  return queued;
+}
+
+/* Cancels W if it is pending.  Returns true if it was, false if
+   it was not queued or has already started.  Does not wait for
+   a running W to finish; workqueue_flush() does that. */
+bool
+work_cancel (struct work *w)
+{
+  enum intr_level old_level;
+  bool cancelled = false;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  if (w->delayed)
+    {
+      timer_timeout_cancel (&w->timeout);
+      w->delayed = false;
+      cancelled = true;
+    }
+  else if (w->queued)
+    {
+      /* A worker may already have downed the semaphore for W, in
+         which case it will find one item fewer than it expected
+         and go back to waiting. */
+      list_remove (&w->elem);
+      sema_try_down (&w->wq->ready);
+      w->queued = false;
+      cancelled = true;
+    }
+  if (cancelled)
+    w->wq->cancelled++;
+  intr_set_level (old_level);
+  return cancelled;
+}
+
+/* Returns true if W is queued or delayed. */
+bool
+work_pending (const struct work *w)
+{
+  return w->queued || w->delayed;
+}
+
+/* Wakes the threads waiting for WQ to become idle, if it is.
+   Interrupts must be off. */
+static void
+wake_flushers (struct workqueue *wq)
+{
+  if (wq->active == 0 && list_empty (&wq->items))
+    while (!list_empty (&wq->flushers))
+      sema_up (&list_entry (list_pop_front (&wq->flushers),
+                            struct flusher, elem)->done);
+}
+
+/* Waits until WQ has no items queued or running.  Delayed items
+   that are not yet due are not waited for.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  struct flusher f;
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  if (wq->active > 0 || !list_empty (&wq->items))
+    {
+      sema_init (&f.done, 0);
+      list_push_back (&wq->flushers, &f.elem);
+      sema_down (&f.done);
+    }
+  intr_set_level (old_level);
+}
+
+/* A worker thread of work queue WQ_. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *w;
+
+      sema_down (&wq->ready);
+
+      old_level = intr_disable ();
+      if (list_empty (&wq->items))
+        {
+          /* Cancelled after we were woken. */
+          intr_set_level (old_level);
+          continue;
+        }
+      w = list_entry (list_pop_front (&wq->items), struct work, elem);
+      w->queued = false;
+      wq->active++;
+      wq->wait_ticks += timer_ticks () - w->queue_time;
+      intr_set_level (old_level);
+
+      /* W may be freed or queued again from here on. */
+      w->func (w);
+
+      old_level = intr_disable ();
+      wq->active--;
+      wq->executed++;
+      wake_flushers (wq);
+      intr_set_level (old_level);
+    }
+}
+
+/* Prints statistics for every work queue. */
+void
+workqueue_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_queues); e != list_end (&all_queues);
+       e = list_next (e))
+    {
+      struct workqueue *wq = list_entry (e, struct workqueue, elem);
+
+      printf ("Work queue %s: %d workers, %lu queued (%lu delayed), "
+              "%lu run, %lu cancelled, max depth %d, "
+              "%"PRId64" ticks waiting\n",
+              wq->name, wq->max_active, wq->queued, wq->delayed,
+              wq->executed, wq->cancelled, wq->max_depth, wq->wait_ticks);
+    }
+}
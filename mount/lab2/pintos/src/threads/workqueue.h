@@ -0,0 +1,48 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+struct work;
+struct workqueue;
+
+/* Runs work item W.  W may be queued again, or freed, by the
+   function itself. */
+typedef void work_func (struct work *w);
+
+/* A work item.  Embed it in the structure that describes the
+   work and recover that with list_entry()-style arithmetic, or
+   use AUX. */
+struct work
+  {
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* For FUNC's use. */
+
+    /* Owned by workqueue.c. */
+    struct workqueue *wq;       /* Queue it is pending on, or null. */
+    bool queued;                /* On wq's list? */
+    bool delayed;               /* Waiting for TIMEOUT? */
+    int64_t queue_time;         /* When it was queued. */
+    struct list_elem elem;      /* Element in wq's list. */
+    struct timer_timeout timeout; /* Fires delayed work. */
+  };
+
+/* Shared queue for work that needs no queue of its own. */
+extern struct workqueue *system_wq;
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int max_active);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct workqueue *, struct work *);
+bool work_queue_delayed (struct workqueue *, struct work *, int64_t ticks);
+bool work_cancel (struct work *);
+bool work_pending (const struct work *);
+void workqueue_flush (struct workqueue *);
+
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
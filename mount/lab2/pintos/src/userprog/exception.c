@@ -2,8 +2,14 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/uthread.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#include "vm/stats.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -67,6 +73,35 @@ exception_print_stats (void)
   printf ("Exception: %lld page faults\n", page_fault_cnt);
 }
 
+/* The instruction in copy_user() that may fault on user memory,
+   and where it resumes when it does. */
+extern char copy_user_insn[], copy_user_fixup[];
+
+/* Copies SIZE bytes from SRC to DST, either of which may be user
+   memory the caller checked earlier.  Returns true if
+   successful, false if a user page was gone by the time of the
+   copy, as when another thread of the process unmaps it
+   meanwhile.  The kernel must access user memory only through
+   this function once it may have changed since it was checked;
+   any other kernel fault is a bug. */
+NO_INLINE bool
+copy_user (void *dst, const void *src, size_t size)
+{
+  bool ok;
+
+  /* page_fault() clears AL and resumes at copy_user_fixup if the
+     copy faults on a page it cannot bring in. */
+  asm volatile ("movb $1, %0\n"
+                ".globl copy_user_insn\n"
+                "copy_user_insn:\n\t"
+                "rep movsb\n"
+                ".globl copy_user_fixup\n"
+                "copy_user_fixup:"
+                : "=&a" (ok), "+D" (dst), "+S" (src), "+c" (size)
+                : : "memory");
+  return ok;
+}
+
 /* Handler for an exception (probably) caused by a user process. */
 static void
 kill (struct intr_frame *f) 
@@ -89,7 +124,7 @@ kill (struct intr_frame *f)
       printf ("%s: dying due to interrupt %#04x (%s).\n",
               thread_name (), f->vec_no, intr_name (f->vec_no));
       intr_dump_frame (f);
-      thread_exit (); 
+      uthread_exit_process (-1);
 
     case SEL_KCSEG:
       /* Kernel's code segment, which indicates a kernel bug.
@@ -126,6 +161,9 @@ page_fault (struct intr_frame *f)
   bool write;        /* True: access was write, false: access was read. */
   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
+#ifdef VM
+  uint64_t start = vm_stats_fault_begin ();
+#endif
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -148,14 +186,46 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* Bring in the page.  Only a fault in user code tells us the
+     user stack pointer, so the kernel can't grow the stack.  A
+     write to a present page may be the first write to the shared
+     zero page. */
+  if (not_present || write)
+    {
+      enum vm_fault_source source;
+      bool major;
+
+      if (page_fault_in (fault_addr, write, user ? f->esp : NULL,
+                         &source, &major))
+        {
+          vm_stats_fault_end (start, source, major);
+          return;
+        }
+    }
+#endif
+
+  /* A gone user page that copy_user() touched fails the copy
+     rather than the kernel. */
+  if (!user && is_user_vaddr (fault_addr)
+      && (void *) f->eip == copy_user_insn)
+    {
+      f->eip = (void (*) (void)) copy_user_fixup;
+      f->eax = 0;
+#ifdef VM
+      vm_stats_fault_end (start, VM_FAULT_INVALID, false);
+#endif
+      return;
+    }
+
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
           write ? "writing" : "reading",
           user ? "user" : "kernel");
+#ifdef VM
+  vm_stats_fault_end (start, VM_FAULT_INVALID, false);
+#endif
   kill (f);
 }
 
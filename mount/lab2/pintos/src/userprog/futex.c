@@ -0,0 +1,164 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/exception.h"
+#include "userprog/uthread.h"
+
+/* Futexes.
+
+   A futex is a word of user memory that user code updates with
+   atomic instructions, entering the kernel only to sleep until
+   the word changes (futex_wait()) or to wake sleepers after
+   changing it (futex_wake()).  An uncontended user-space lock
+   never makes a system call.
+
+   Sleepers wait in a fixed table of buckets hashed by address
+   space and user address.  Keying by physical address, as Linux
+   does for futexes in shared memory, would break when the
+   page is evicted and comes back in another frame, and the
+   only memory processes share here is read-only code
+   (vm/pcache.c), which holds no futexes. */
+
+#define FUTEX_BUCKETS 64
+
+/* A hash bucket. */
+struct futex_bucket
+  {
+    struct lock lock;           /* Protects waiters. */
+    struct list waiters;        /* Threads sleeping in futex_wait(). */
+  };
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter
+  {
+    uint32_t *pagedir;          /* Address space. */
+    const int *uaddr;           /* User address of the word. */
+    struct semaphore sema;      /* Upped by futex_wake(). */
+    struct list_elem elem;      /* Element in bucket's waiters. */
+  };
+
+/* Initializes the futex table. */
+void
+futex_init (void)
+{
+  struct futex_bucket *b;
+
+  for (b = buckets; b < buckets + FUTEX_BUCKETS; b++)
+    {
+      lock_init (&b->lock);
+      list_init (&b->waiters);
+    }
+}
+
+/* Returns the bucket for the word at UADDR in the current
+   process. */
+static struct futex_bucket *
+bucket_for (const int *uaddr)
+{
+  unsigned h = hash_int ((int) (uintptr_t) uaddr)
+               ^ hash_int ((int) (uintptr_t) thread_current ()->pagedir);
+  return &buckets[h % FUTEX_BUCKETS];
+}
+
+/* Sleeps until futex_wake() wakes the word at UADDR, if it
+   still holds EXPECTED.  Returns 0 after sleeping, or -1 at once
+   if the word had changed or the process is exiting.  UADDR must
+   be a valid, aligned user address in the current process. */
+int
+futex_wait (const int *uaddr, int expected)
+{
+  struct futex_bucket *b = bucket_for (uaddr);
+  struct futex_waiter w;
+  int word;
+
+  ASSERT ((uintptr_t) uaddr % sizeof *uaddr == 0);
+
+  /* Checking the word with the bucket locked makes the check and
+     going to sleep atomic with respect to futex_wake(), so a
+     wake-up after the word changes cannot be lost, nor can
+     futex_wake_all() miss a thread going to sleep as its process
+     begins to exit. */
+  lock_acquire (&b->lock);
+  if (!copy_user (&word, uaddr, sizeof word))
+    {
+      /* Another thread unmapped the word. */
+      lock_release (&b->lock);
+      uthread_exit_process (-1);
+    }
+  if (uthread_dying () || word != expected)
+    {
+      lock_release (&b->lock);
+      return -1;
+    }
+  w.pagedir = thread_current ()->pagedir;
+  w.uaddr = uaddr;
+  sema_init (&w.sema, 0);
+  list_push_back (&b->waiters, &w.elem);
+  lock_release (&b->lock);
+
+  sema_down (&w.sema);
+  return 0;
+}
+
+/* Wakes up to N threads sleeping on the word at UADDR in the
+   current process, in the order they went to sleep.  Returns
+   the number woken. */
+int
+futex_wake (const int *uaddr, int n)
+{
+  struct futex_bucket *b = bucket_for (uaddr);
+  uint32_t *pd = thread_current ()->pagedir;
+  struct list_elem *e;
+  int woken = 0;
+
+  lock_acquire (&b->lock);
+  for (e = list_begin (&b->waiters); e != list_end (&b->waiters) && woken < n;)
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+      if (w->pagedir == pd && w->uaddr == uaddr)
+        {
+          e = list_remove (e);
+          sema_up (&w->sema);
+          woken++;
+        }
+      else
+        e = list_next (e);
+    }
+  lock_release (&b->lock);
+  return woken;
+}
+
+/* Wakes every thread sleeping on any word in the address space
+   PAGEDIR, whose process is exiting. */
+void
+futex_wake_all (uint32_t *pagedir)
+{
+  struct futex_bucket *b;
+
+  for (b = buckets; b < buckets + FUTEX_BUCKETS; b++)
+    {
+      struct list_elem *e;
+
+      lock_acquire (&b->lock);
+      for (e = list_begin (&b->waiters); e != list_end (&b->waiters);)
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+          if (w->pagedir == pagedir)
+            {
+              e = list_remove (e);
+              sema_up (&w->sema);
+            }
+          else
+            e = list_next (e);
+        }
+      lock_release (&b->lock);
+    }
+}
@@ -7,50 +7,144 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/uthread.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#include "vm/stats.h"
+#endif
+
+/* A process as the thread that started it sees it.  The two
+   share it, and whichever is done with it last frees it. */
+struct child
+  {
+    tid_t tid;                  /* The process's leader. */
+    int exit_status;            /* Its exit status, once it exited. */
+    bool loaded;                /* Did its executable load? */
+    struct semaphore load_done; /* Upped once load() is over. */
+    struct semaphore exited;    /* Upped when the process exits. */
+    int refs;                   /* Users left: parent and child. */
+    struct list_elem elem;      /* Element in the parent's children. */
+  };
+
+/* What a new process needs to start. */
+struct exec_info
+  {
+    char *cmd_line;             /* Command line, in its own page. */
+    struct child *child;        /* The process's record. */
+  };
 
 static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static bool load (const char *cmd_line, void (**eip) (void), void **esp);
+
+/* Copies the first word of CMD_LINE, the name of the program to
+   run, into NAME, which has room for SIZE bytes.  Returns false
+   if there is no such word or it does not fit. */
+static bool
+program_name (const char *cmd_line, char *name, size_t size)
+{
+  size_t len;
+
+  cmd_line += strspn (cmd_line, " ");
+  len = strcspn (cmd_line, " ");
+  if (len == 0 || len >= size)
+    return false;
+  strlcpy (name, cmd_line, len + 1);
+  return true;
+}
+
+/* Lets go of C, freeing it if the other side already has. */
+static void
+put_child (struct child *c)
+{
+  enum intr_level old_level;
+  bool last;
+
+  old_level = intr_disable ();
+  last = --c->refs == 0;
+  intr_set_level (old_level);
+  if (last)
+    free (c);
+}
 
-/* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+/* Starts a new thread running a user program loaded from the
+   file named by the first word of CMD_LINE, passing it the words
+   of CMD_LINE as arguments.  Waits for the executable to load.
+   Returns the new process's thread id, or TID_ERROR if the
+   thread cannot be created or the program cannot be loaded. */
 tid_t
-process_execute (const char *file_name) 
+process_execute (const char *cmd_line) 
 {
-  char *fn_copy;
+  char name[sizeof thread_current ()->name];
+  struct exec_info info;
+  struct child *c;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
+  /* The thread is named after the program.  A longer name could
+     not be a file name anyway. */
+  if (!program_name (cmd_line, name, sizeof name))
+    return TID_ERROR;
+
+  /* Make a copy of CMD_LINE.
      Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  info.cmd_line = palloc_get_page (0);
+  if (info.cmd_line == NULL)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
+  strlcpy (info.cmd_line, cmd_line, PGSIZE);
 
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
+  c = info.child = malloc (sizeof *c);
+  if (c == NULL)
+    {
+      palloc_free_page (info.cmd_line);
+      return TID_ERROR;
+    }
+  c->exit_status = -1;
+  c->loaded = false;
+  sema_init (&c->load_done, 0);
+  sema_init (&c->exited, 0);
+  c->refs = 2;
+
+  /* Create a new thread to execute the program. */
+  tid = thread_create (name, PRI_DEFAULT, start_process, &info);
   if (tid == TID_ERROR)
-    palloc_free_page (fn_copy); 
+    {
+      palloc_free_page (info.cmd_line);
+      free (c);
+      return TID_ERROR;
+    }
+
+  /* The child is done with INFO once it has loaded. */
+  sema_down (&c->load_done);
+  if (!c->loaded)
+    {
+      put_child (c);
+      return TID_ERROR;
+    }
+  c->tid = tid;
+  list_push_back (&thread_current ()->children, &c->elem);
   return tid;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *info_)
 {
-  char *file_name = file_name_;
+  struct exec_info *info = info_;
+  struct thread *t = thread_current ();
+  char *cmd_line = info->cmd_line;
   struct intr_frame if_;
   bool success;
 
@@ -59,10 +153,16 @@ start_process (void *file_name_)
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (file_name, &if_.eip, &if_.esp);
+  t->child = info->child;
+  uthread_group_init (&t->uthreads);
+  success = load (cmd_line, &if_.eip, &if_.esp);
+
+  /* Tell the parent how it went.  INFO is gone after this. */
+  palloc_free_page (cmd_line);
+  t->child->loaded = success;
+  sema_up (&t->child->load_done);
 
   /* If load failed, quit. */
-  palloc_free_page (file_name);
   if (!success) 
     thread_exit ();
 
@@ -79,18 +179,45 @@ start_process (void *file_name_)
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
-   child of the calling process, or if process_wait() has already
+   child of the calling thread, or if process_wait() has already
    been successfully called for the given TID, returns -1
-   immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   immediately, without waiting. */
 int
-process_wait (tid_t child_tid UNUSED) 
+process_wait (tid_t child_tid) 
 {
+  struct list *children = &thread_current ()->children;
+  struct list_elem *e;
+
+  for (e = list_begin (children); e != list_end (children);
+       e = list_next (e))
+    {
+      struct child *c = list_entry (e, struct child, elem);
+
+      if (c->tid == child_tid)
+        {
+          int status;
+
+          list_remove (&c->elem);
+          sema_down (&c->exited);
+          status = c->exit_status;
+          put_child (c);
+          return status;
+        }
+    }
   return -1;
 }
 
+/* Lets go of the records of the current thread's children, which
+   it can no longer wait for. */
+static void
+release_children (void)
+{
+  struct list *children = &thread_current ()->children;
+
+  while (!list_empty (children))
+    put_child (list_entry (list_pop_front (children), struct child, elem));
+}
+
 /* Free the current process's resources. */
 void
 process_exit (void)
@@ -98,6 +225,40 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  release_children ();
+  if (cur->leader != cur)
+    {
+      /* Another thread of the process.  The leader frees the
+         address space once we are all gone. */
+      cur->pagedir = NULL;
+      pagedir_activate (NULL);
+      uthread_exited ();
+      return;
+    }
+  if (cur->pagedir != NULL)
+    uthread_join_all ();
+  if (cur->child != NULL)
+    printf ("%s: exit(%d)\n", cur->name, cur->exit_status);
+
+  /* The other threads are gone, so nothing uses the files now. */
+  syscall_close_files ();
+
+#ifdef VM
+  vm_stats_process_exit ();
+
+  /* Free the pages while the page directory still maps them, then
+     the executable that backs them. */
+  if (cur->pagedir != NULL)
+    page_table_destroy ();
+#endif
+  if (cur->exec_file != NULL)
+    {
+      lock_acquire (&filesys_lock);
+      file_close (cur->exec_file);
+      lock_release (&filesys_lock);
+      cur->exec_file = NULL;
+    }
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -114,6 +275,15 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  /* Only now that its memory is free is the process gone. */
+  if (cur->child != NULL)
+    {
+      cur->child->exit_status = cur->exit_status;
+      sema_up (&cur->child->exited);
+      put_child (cur->child);
+      cur->child = NULL;
+    }
 }
 
 /* Sets up the CPU for running user code in the current
@@ -195,30 +365,45 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
-static bool setup_stack (void **esp);
+static bool setup_stack (void **esp, const char *cmd_line);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Loads an ELF executable from the file named by the first word
+   of CMD_LINE into the current thread.
    Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
+   and its initial stack pointer into *ESP, with the words of
+   CMD_LINE on the stack as the arguments to main().
    Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+load (const char *cmd_line, void (**eip) (void), void **esp) 
 {
   struct thread *t = thread_current ();
+  char file_name[NAME_MAX + 1];
   struct Elf32_Ehdr ehdr;
   struct file *file = NULL;
   off_t file_ofs;
   bool success = false;
   int i;
 
+  if (!program_name (cmd_line, file_name, sizeof file_name))
+    return false;
+  lock_acquire (&filesys_lock);
+
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
+#ifdef VM
+  if (!page_table_init ())
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto done;
+    }
+#endif
   process_activate ();
 
   /* Open executable file. */
@@ -302,23 +487,32 @@ load (const char *file_name, void (**eip) (void), void **esp)
     }
 
   /* Set up stack. */
-  if (!setup_stack (esp))
+  if (!setup_stack (esp, cmd_line))
     goto done;
 
   /* Start address. */
   *eip = (void (*) (void)) ehdr.e_entry;
 
+  /* Keep the executable open, and unchanged, while the process
+     runs.  Under VM its pages are read from it as they are
+     touched. */
   success = true;
+  file_deny_write (file);
+  t->exec_file = file;
+  file = NULL;
 
  done:
   /* We arrive here whether the load is successful or not. */
   file_close (file);
+  lock_release (&filesys_lock);
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -387,7 +581,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Calculate how to fill this page.
@@ -396,6 +592,16 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from; page_fault_in() loads
+         it on first touch. */
+      if ((page_read_bytes > 0
+           ? page_add_file (upage, writable, file, ofs, page_read_bytes)
+           : page_add_zero (upage, writable)) == NULL)
+        return false;
+      ofs += page_read_bytes;
+#else
+
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -415,6 +621,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -424,11 +631,63 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   return true;
 }
 
+/* Pushes the words of CMD_LINE onto the stack page at the top of
+   user virtual memory, which must be mapped, as the arguments to
+   main() that lib/user/entry.c expects, and points *ESP at them.
+   Returns false if they do not fit in the page. */
+static bool
+push_args (void **esp, const char *cmd_line)
+{
+  size_t len = strlen (cmd_line) + 1;
+  char *line, *word, *save_ptr;
+  char **argv;
+  uint32_t *sp;
+  int argc, i;
+
+  /* Copy the command line to the top of the stack and split it
+     into words there, in place. */
+  if (len > PGSIZE / 2)
+    return false;
+  line = (char *) PHYS_BASE - len;
+  strlcpy (line, cmd_line, len);
+  argc = 0;
+  for (word = strtok_r (line, " ", &save_ptr); word != NULL;
+       word = strtok_r (NULL, " ", &save_ptr))
+    argc++;
+
+  /* Then the word-aligned argv[] below it.  Each word now ends
+     in a null, perhaps followed by leftover spaces. */
+  argv = (char **) ROUND_DOWN ((uintptr_t) line, sizeof (char *)) - (argc + 1);
+  if ((uint8_t *) (argv - 3) < (uint8_t *) PHYS_BASE - PGSIZE)
+    return false;
+  for (i = 0, word = line; i < argc; word++)
+    if (*word != ' ' && *word != '\0'
+        && (word == line || word[-1] == ' ' || word[-1] == '\0'))
+      argv[i++] = word;
+  argv[argc] = NULL;
+
+  /* And main()'s frame: a null return address, argc and argv. */
+  sp = (uint32_t *) argv - 3;
+  sp[0] = 0;
+  sp[1] = argc;
+  sp[2] = (uint32_t) argv;
+  *esp = sp;
+  return true;
+}
+
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory, holding the words of CMD_LINE as the
+   program's arguments. */
 static bool
-setup_stack (void **esp) 
+setup_stack (void **esp, const char *cmd_line) 
 {
+#ifdef VM
+  /* The page is zeroed when first touched, which pushing the
+     arguments does, and the stack grows on demand below it. */
+  if (page_add_zero (((uint8_t *) PHYS_BASE) - PGSIZE, true) == NULL)
+    return false;
+  return push_args (esp, cmd_line);
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -437,13 +696,15 @@ setup_stack (void **esp)
     {
       success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
       if (success)
-        *esp = PHYS_BASE;
+        success = push_args (esp, cmd_line);
       else
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -463,3 +724,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
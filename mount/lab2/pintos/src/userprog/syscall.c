@@ -1,20 +1,633 @@
 #include "userprog/syscall.h"
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "devices/input.h"
+#include "devices/shutdown.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/exception.h"
+#include "userprog/futex.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/uthread.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* System calls.
+
+   Arguments are words on the user stack, checked one by one as
+   they are read.  Buffers and strings are checked page by page
+   before the kernel touches them, and then copied with
+   copy_user(): under VM a page swapped out meanwhile faults back
+   in as for user code, and one that another thread unmapped
+   meanwhile fails the copy, ending the process.  The file system
+   holds locks that paging needs (the page cache's, the disk
+   controller's) while it copies data, and the console its own,
+   so their data passes through a kernel page rather than letting
+   them fault on user memory.
+
+   The file system is not thread safe, so its calls are
+   serialized by filesys_lock, which also protects the processes'
+   file descriptor tables and lists of mapped files.  A process's
+   threads share them, kept by its leader.  Mapping files needs
+   the supplemental page table, so only VM kernels have mmap(). */
+
+/* Serializes file system calls. */
+struct lock filesys_lock;
+
+/* An open file, an entry in a process's file descriptor table. */
+struct open_file
+  {
+    int fd;                     /* File descriptor. */
+    struct file *file;          /* The file. */
+    struct list_elem elem;      /* Element in the leader's files. */
+  };
+
+/* A mapped file, an entry in a process's list of mappings. */
+struct mapping
+  {
+    int id;                     /* Mapping identifier. */
+    struct file *file;          /* Its own handle on the file. */
+    void *addr;                 /* Where it is mapped. */
+    off_t length;               /* Bytes mapped. */
+    struct list_elem elem;      /* Element in the leader's mappings. */
+  };
 
 static void syscall_handler (struct intr_frame *);
+static void kill_process (void) NO_RETURN;
+static void sys_exit (int status) NO_RETURN;
 
 void
-syscall_init (void) 
+syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  lock_init (&filesys_lock);
+  futex_init ();
+}
+
+/* Terminates the current process for passing a bad argument,
+   with exit status -1. */
+static void
+kill_process (void)
+{
+  uthread_exit_process (-1);
+}
+
+/* Returns true if the current process may read the aligned word
+   at UADDR.  Under VM the page may be swapped out; reading it
+   faults it back in. */
+static bool
+is_user_word (const void *uaddr)
+{
+  if ((uintptr_t) uaddr % sizeof (int) != 0 || !is_user_vaddr (uaddr))
+    return false;
+#ifdef VM
+  return page_lookup (pg_round_down (uaddr)) != NULL;
+#else
+  return pagedir_get_page (thread_current ()->pagedir, uaddr) != NULL;
+#endif
+}
+
+/* Returns the word at UADDR, terminating the process if it may
+   not read it. */
+static int
+get_user_word (const int *uaddr)
+{
+  int word;
+
+  if (!is_user_word (uaddr) || !copy_user (&word, uaddr, sizeof word))
+    kill_process ();
+  return word;
+}
+
+/* Returns the futex address passed in the argument at ARG,
+   terminating the process if it may not read the word there. */
+static int *
+get_futex_arg (const int *arg)
+{
+  int *uaddr = (int *) get_user_word (arg);
+
+  if (!is_user_word (uaddr))
+    kill_process ();
+  return uaddr;
+}
+
+/* Returns true if the current process may read the byte at
+   UADDR or, if WRITE, write it.  Under VM, an address just below
+   the user stack pointer ESP grows the stack, as it would if
+   user code touched it. */
+static bool
+is_user_byte (const void *uaddr, bool write, const void *esp UNUSED)
+{
+#ifdef VM
+  struct page *p;
+  enum vm_fault_source source;
+  bool major;
+
+  p = page_lookup (pg_round_down (uaddr));
+  if (p != NULL)
+    return !write || p->writable;
+  return page_fault_in (uaddr, true, esp, &source, &major);
+#else
+  uint32_t *pd = thread_current ()->pagedir;
+
+  return (write
+          ? pagedir_is_writable (pd, uaddr)
+          : pagedir_get_page (pd, uaddr) != NULL);
+#endif
+}
+
+/* Terminates the process unless it may access the SIZE bytes at
+   UBUF, reading them or, if WRITE, writing them.  ESP is the
+   user stack pointer. */
+static void
+check_user_buffer (const void *ubuf, size_t size, bool write,
+                   const void *esp)
+{
+  const uint8_t *p = ubuf;
+  const uint8_t *end = p + size;
+
+  if (size == 0)
+    return;
+  if (end < p || !is_user_vaddr (end - 1))
+    kill_process ();
+  for (; p < end; p = (const uint8_t *) pg_round_down (p) + PGSIZE)
+    if (!is_user_byte (p, write, esp))
+      kill_process ();
+}
+
+/* Copies the null-terminated string at USTR into a new page,
+   truncating it to fit, and returns the page, which the caller
+   must free with palloc_free_page().  Terminates the process if
+   it may not read the string.  Returns a null pointer if memory
+   is short. */
+static char *
+copy_in_string (const char *ustr)
+{
+  char *kstr;
+  size_t i;
+
+  kstr = palloc_get_page (0);
+  if (kstr == NULL)
+    return NULL;
+  for (i = 0; i < PGSIZE - 1; i++)
+    {
+      if ((i == 0 || pg_ofs (ustr + i) == 0)
+          && (!is_user_vaddr (ustr + i)
+              || !is_user_byte (ustr + i, false, NULL)))
+        {
+          palloc_free_page (kstr);
+          kill_process ();
+        }
+      if (!copy_user (kstr + i, ustr + i, 1))
+        {
+          palloc_free_page (kstr);
+          kill_process ();
+        }
+      if (kstr[i] == '\0')
+        return kstr;
+    }
+  kstr[i] = '\0';
+  return kstr;
+}
+
+/* Returns the current process's open file FD, or a null pointer
+   if FD is not open.  The caller must hold filesys_lock. */
+static struct open_file *
+lookup_fd (int fd)
+{
+  struct list *files = &thread_current ()->leader->files;
+  struct list_elem *e;
+
+  for (e = list_begin (files); e != list_end (files); e = list_next (e))
+    {
+      struct open_file *of = list_entry (e, struct open_file, elem);
+      if (of->fd == fd)
+        return of;
+    }
+  return NULL;
+}
+
+/* Returns the file open as FD in the current process, or a null
+   pointer if FD is not open.  The caller must hold
+   filesys_lock. */
+static struct file *
+lookup_file (int fd)
+{
+  struct open_file *of = lookup_fd (fd);
+  return of != NULL ? of->file : NULL;
+}
+
+/* Removes mapping M, which must be off its list, writing back
+   the pages that were modified, and frees it. */
+static void
+unmap (struct mapping *m)
+{
+#ifdef VM
+  page_unmap_file (m->addr, m->length);
+#endif
+  lock_acquire (&filesys_lock);
+  file_close (m->file);
+  lock_release (&filesys_lock);
+  free (m);
+}
+
+/* Unmaps every file the current process has mapped and closes
+   every file it has open.  Called by process_exit() in the
+   leader once its other threads are gone, while the address
+   space still exists. */
+void
+syscall_close_files (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_pop_front (&t->mappings), struct mapping, elem));
+
+  if (list_empty (&t->files))
+    return;
+  lock_acquire (&filesys_lock);
+  while (!list_empty (&t->files))
+    {
+      struct open_file *of = list_entry (list_pop_front (&t->files),
+                                         struct open_file, elem);
+      file_close (of->file);
+      free (of);
+    }
+  lock_release (&filesys_lock);
+}
+
+/* Reads SIZE bytes from open file FD into user buffer UBUF, or
+   if WRITE writes SIZE bytes from UBUF to FD, a page at a time
+   through a kernel page.  FD may be the console.  Returns the
+   number of bytes transferred, or -1 if FD is not open or memory
+   is short.  Terminates the process if part of UBUF is
+   unmapped meanwhile. */
+static int
+transfer (int fd, uint8_t *ubuf, unsigned size, bool write)
+{
+  uint8_t *bounce;
+  unsigned done = 0;
+  bool faulted = false;
+  int result = -1;
+
+  bounce = palloc_get_page (0);
+  if (bounce == NULL)
+    return -1;
+  for (;;)
+    {
+      unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+      struct file *file;
+      off_t n = -1;
+
+      if (write && !copy_user (bounce, ubuf + done, chunk))
+        {
+          faulted = true;
+          break;
+        }
+
+      if (write && fd == STDOUT_FILENO)
+        {
+          putbuf ((const char *) bounce, chunk);
+          n = chunk;
+        }
+      else if (!write && fd == STDIN_FILENO)
+        {
+          for (n = 0; (unsigned) n < chunk; n++)
+            bounce[n] = input_getc ();
+        }
+      else
+        {
+          /* Another thread of the process may close FD
+             meanwhile. */
+          lock_acquire (&filesys_lock);
+          file = lookup_file (fd);
+          if (file != NULL)
+            n = (write
+                 ? file_write (file, bounce, chunk)
+                 : file_read (file, bounce, chunk));
+          lock_release (&filesys_lock);
+        }
+
+      if (n < 0)
+        {
+          result = done > 0 ? (int) done : -1;
+          break;
+        }
+      if (!write && !copy_user (ubuf + done, bounce, n))
+        {
+          faulted = true;
+          break;
+        }
+      done += n;
+      if (done == size || (unsigned) n < chunk)
+        {
+          result = done;
+          break;
+        }
+    }
+  palloc_free_page (bounce);
+  if (faulted)
+    kill_process ();
+  return result;
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+sys_exit (int status)
 {
-  printf ("system call!\n");
-  thread_exit ();
+  uthread_exit_process (status);
+}
+
+static int
+sys_exec (const char *ucmd_line)
+{
+  char *cmd_line = copy_in_string (ucmd_line);
+  tid_t tid;
+
+  if (cmd_line == NULL)
+    return -1;
+  tid = process_execute (cmd_line);
+  palloc_free_page (cmd_line);
+  return tid;
+}
+
+static bool
+sys_create (const char *ufile, unsigned initial_size)
+{
+  char *file = copy_in_string (ufile);
+  bool success;
+
+  if (file == NULL)
+    return false;
+  lock_acquire (&filesys_lock);
+  success = filesys_create (file, initial_size);
+  lock_release (&filesys_lock);
+  palloc_free_page (file);
+  return success;
+}
+
+static bool
+sys_remove (const char *ufile)
+{
+  char *file = copy_in_string (ufile);
+  bool success;
+
+  if (file == NULL)
+    return false;
+  lock_acquire (&filesys_lock);
+  success = filesys_remove (file);
+  lock_release (&filesys_lock);
+  palloc_free_page (file);
+  return success;
+}
+
+static int
+sys_open (const char *ufile)
+{
+  struct thread *leader = thread_current ()->leader;
+  char *file = copy_in_string (ufile);
+  struct open_file *of;
+  int fd = -1;
+
+  if (file == NULL)
+    return -1;
+  of = malloc (sizeof *of);
+  if (of != NULL)
+    {
+      lock_acquire (&filesys_lock);
+      of->file = filesys_open (file);
+      if (of->file != NULL)
+        {
+          fd = of->fd = leader->next_fd++;
+          list_push_back (&leader->files, &of->elem);
+        }
+      lock_release (&filesys_lock);
+      if (fd < 0)
+        free (of);
+    }
+  palloc_free_page (file);
+  return fd;
+}
+
+static int
+sys_filesize (int fd)
+{
+  struct file *file;
+  int size = -1;
+
+  lock_acquire (&filesys_lock);
+  file = lookup_file (fd);
+  if (file != NULL)
+    size = file_length (file);
+  lock_release (&filesys_lock);
+  return size;
+}
+
+static int
+sys_read (int fd, void *ubuf, unsigned size, const void *esp)
+{
+  check_user_buffer (ubuf, size, true, esp);
+  return transfer (fd, ubuf, size, false);
+}
+
+static int
+sys_write (int fd, const void *ubuf, unsigned size, const void *esp)
+{
+  check_user_buffer (ubuf, size, false, esp);
+  return transfer (fd, (uint8_t *) ubuf, size, true);
+}
+
+static void
+sys_seek (int fd, unsigned position)
+{
+  struct file *file;
+
+  lock_acquire (&filesys_lock);
+  file = lookup_file (fd);
+  if (file != NULL)
+    file_seek (file, position);
+  lock_release (&filesys_lock);
+}
+
+static unsigned
+sys_tell (int fd)
+{
+  struct file *file;
+  unsigned position = 0;
+
+  lock_acquire (&filesys_lock);
+  file = lookup_file (fd);
+  if (file != NULL)
+    position = file_tell (file);
+  lock_release (&filesys_lock);
+  return position;
+}
+
+static void
+sys_close (int fd)
+{
+  struct open_file *of;
+
+  lock_acquire (&filesys_lock);
+  of = lookup_fd (fd);
+  if (of != NULL)
+    {
+      list_remove (&of->elem);
+      file_close (of->file);
+    }
+  lock_release (&filesys_lock);
+  free (of);
+}
+
+static int
+sys_mmap (int fd UNUSED, void *addr UNUSED)
+{
+#ifdef VM
+  struct thread *leader = thread_current ()->leader;
+  struct mapping *m;
+  struct file *file;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return -1;
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+
+  /* The mapping gets a handle of its own, so that closing FD
+     leaves it be. */
+  lock_acquire (&filesys_lock);
+  file = lookup_file (fd);
+  m->file = file != NULL ? file_reopen (file) : NULL;
+  m->length = m->file != NULL ? file_length (m->file) : 0;
+  lock_release (&filesys_lock);
+
+  m->addr = addr;
+  if (m->length == 0 || !page_map_file (addr, m->file, m->length))
+    {
+      lock_acquire (&filesys_lock);
+      file_close (m->file);
+      lock_release (&filesys_lock);
+      free (m);
+      return -1;
+    }
+
+  lock_acquire (&filesys_lock);
+  m->id = leader->next_mapid++;
+  list_push_back (&leader->mappings, &m->elem);
+  lock_release (&filesys_lock);
+  return m->id;
+#else
+  return -1;
+#endif
+}
+
+static void
+sys_munmap (int id)
+{
+  struct list *mappings = &thread_current ()->leader->mappings;
+  struct mapping *m = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&filesys_lock);
+  for (e = list_begin (mappings); e != list_end (mappings); e = list_next (e))
+    if (list_entry (e, struct mapping, elem)->id == id)
+      {
+        m = list_entry (e, struct mapping, elem);
+        list_remove (&m->elem);
+        break;
+      }
+  lock_release (&filesys_lock);
+  if (m != NULL)
+    unmap (m);
+}
+
+static void
+syscall_handler (struct intr_frame *f)
+{
+  const int *args = f->esp;
+
+  /* Another thread is ending the process. */
+  if (uthread_dying ())
+    thread_exit ();
+
+  switch (get_user_word (args))
+    {
+    case SYS_HALT:
+      shutdown_power_off ();
+    case SYS_EXIT:
+      sys_exit (get_user_word (args + 1));
+    case SYS_EXEC:
+      f->eax = sys_exec ((const char *) get_user_word (args + 1));
+      return;
+    case SYS_WAIT:
+      f->eax = process_wait (get_user_word (args + 1));
+      return;
+    case SYS_CREATE:
+      f->eax = sys_create ((const char *) get_user_word (args + 1),
+                           get_user_word (args + 2));
+      return;
+    case SYS_REMOVE:
+      f->eax = sys_remove ((const char *) get_user_word (args + 1));
+      return;
+    case SYS_OPEN:
+      f->eax = sys_open ((const char *) get_user_word (args + 1));
+      return;
+    case SYS_FILESIZE:
+      f->eax = sys_filesize (get_user_word (args + 1));
+      return;
+    case SYS_READ:
+      f->eax = sys_read (get_user_word (args + 1),
+                         (void *) get_user_word (args + 2),
+                         get_user_word (args + 3), f->esp);
+      return;
+    case SYS_WRITE:
+      f->eax = sys_write (get_user_word (args + 1),
+                          (const void *) get_user_word (args + 2),
+                          get_user_word (args + 3), f->esp);
+      return;
+    case SYS_SEEK:
+      sys_seek (get_user_word (args + 1), get_user_word (args + 2));
+      return;
+    case SYS_TELL:
+      f->eax = sys_tell (get_user_word (args + 1));
+      return;
+    case SYS_CLOSE:
+      sys_close (get_user_word (args + 1));
+      return;
+    case SYS_MMAP:
+      f->eax = sys_mmap (get_user_word (args + 1),
+                         (void *) get_user_word (args + 2));
+      return;
+    case SYS_MUNMAP:
+      sys_munmap (get_user_word (args + 1));
+      return;
+
+    case SYS_FUTEX_WAIT:
+      f->eax = futex_wait (get_futex_arg (args + 1), get_user_word (args + 2));
+      return;
+    case SYS_FUTEX_WAKE:
+      f->eax = futex_wake (get_futex_arg (args + 1), get_user_word (args + 2));
+      return;
+    case SYS_UTHREAD_CREATE:
+      f->eax = uthread_create ((void (*) (void)) get_user_word (args + 1),
+                               (void *) get_user_word (args + 2),
+                               (void *) get_user_word (args + 3));
+      return;
+    case SYS_UTHREAD_EXIT:
+      uthread_exit (get_user_word (args + 1));
+    case SYS_UTHREAD_JOIN:
+      f->eax = uthread_join (get_user_word (args + 1));
+      return;
+    }
+
+  /* Not a system call we know. */
+  kill_process ();
 }
@@ -1,6 +1,12 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include "threads/synch.h"
+
+/* Serializes file system calls. */
+extern struct lock filesys_lock;
+
 void syscall_init (void);
+void syscall_close_files (void);
 
 #endif /* userprog/syscall.h */
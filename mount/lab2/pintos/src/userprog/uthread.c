@@ -0,0 +1,322 @@
+#include "userprog/uthread.h"
+#include <stdbool.h>
+#include <string.h>
+#include "threads/flags.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/futex.h"
+#include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* User threads.
+
+   A process starts with one thread, its leader, which owns the
+   address space: the page directory and, under VM, the
+   supplemental page table, the executable and the paging
+   accounting.  Threads created with uthread_create() share all
+   of it through their `leader' pointer, and the leader waits for
+   them in process_exit() before tearing it down.  A process
+   whose threads only uthread_exit() lives until its last thread
+   exits, but exit() or a fault in any thread ends all of them:
+   uthread_exit_process() marks the process dying and wakes its
+   futex sleepers, and every other thread exits at its next
+   system call or on its way back to user mode.
+
+   Each thread gets a stack slot of UTHREAD_STACK_PAGES pages
+   below the 8 MB the leader's stack may grow into, with an
+   unmapped guard page under each.  Under VM the pages are
+   zero-fill pages that take no memory until touched; without it
+   only the top page is allocated, as for the leader.  A slot is
+   reused, as is, by the next thread once its thread has been
+   joined. */
+
+#define UTHREAD_MAX 32                  /* Stack slots per process. */
+#define UTHREAD_STACK_PAGES 16          /* 64 kB per stack. */
+#define UTHREAD_STACK_TOP ((uint8_t *) PHYS_BASE - 8 * 1024 * 1024)
+
+/* A thread other than the leader. */
+struct uthread
+  {
+    int tid;                    /* Thread identifier. */
+    int slot;                   /* Stack slot. */
+    int status;                 /* Exit status. */
+    bool exited;                /* Has it exited? */
+    bool joining;               /* Is a thread waiting to join it? */
+    struct list_elem elem;      /* Element in the group's list. */
+  };
+
+/* What a new thread needs to start. */
+struct start_info
+  {
+    struct thread *leader;      /* Leader of the process. */
+    struct uthread *self;       /* The new thread's record. */
+    void (*eip) (void);         /* User code to start at. */
+    void *esp;                  /* User stack pointer. */
+    struct semaphore started;   /* Upped once the above was read. */
+  };
+
+/* Initializes GROUP, in a process's leader, as empty. */
+void
+uthread_group_init (struct uthread_group *group)
+{
+  lock_init (&group->lock);
+  cond_init (&group->exited);
+  list_init (&group->threads);
+  group->live = 0;
+  group->stacks = 0;
+  group->dying = false;
+}
+
+/* Returns the top of the stack in SLOT. */
+static uint8_t *
+stack_top (int slot)
+{
+  return UTHREAD_STACK_TOP - slot * (UTHREAD_STACK_PAGES + 1) * PGSIZE;
+}
+
+/* Makes sure the stack in SLOT is mapped.  Returns false if
+   memory is short. */
+static bool
+map_stack (int slot)
+{
+  uint8_t *top = stack_top (slot);
+#ifdef VM
+  int i;
+
+  for (i = 1; i <= UTHREAD_STACK_PAGES; i++)
+    if (page_lookup (top - i * PGSIZE) == NULL
+        && page_add_zero (top - i * PGSIZE, true) == NULL)
+      return false;
+  return true;
+#else
+  uint32_t *pd = thread_current ()->pagedir;
+  uint8_t *kpage;
+
+  if (pagedir_get_page (pd, top - PGSIZE) != NULL)
+    return true;
+  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (kpage == NULL)
+    return false;
+  if (!pagedir_set_page (pd, top - PGSIZE, kpage, true))
+    {
+      palloc_free_page (kpage);
+      return false;
+    }
+  return true;
+#endif
+}
+
+/* A thread function that enters the user thread described by
+   INFO_. */
+static void
+start_uthread (void *info_)
+{
+  struct start_info *info = info_;
+  struct thread *t = thread_current ();
+  struct intr_frame if_;
+
+  t->leader = info->leader;
+  t->uthread = info->self;
+  t->pagedir = info->leader->pagedir;
+  process_activate ();
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = info->eip;
+  if_.esp = info->esp;
+  sema_up (&info->started);
+
+  /* Enter user mode as start_process() does. */
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Starts a new thread in the current process, running user code
+   at START as if called with arguments ARG0 and ARG1.  Returns
+   its thread identifier, or TID_ERROR if it could not be
+   created. */
+int
+uthread_create (void (*start) (void), void *arg0, void *arg1)
+{
+  struct thread *leader = thread_current ()->leader;
+  struct uthread_group *group = &leader->uthreads;
+  struct start_info info;
+  struct uthread *ut;
+  uint32_t *esp;
+  int slot;
+
+  ut = malloc (sizeof *ut);
+  if (ut == NULL)
+    return TID_ERROR;
+
+  lock_acquire (&group->lock);
+  for (slot = 0; slot < UTHREAD_MAX; slot++)
+    if (!(group->stacks & (1u << slot)))
+      break;
+  if (group->dying || slot == UTHREAD_MAX || !map_stack (slot))
+    {
+      lock_release (&group->lock);
+      free (ut);
+      return TID_ERROR;
+    }
+  group->stacks |= 1u << slot;
+  group->live++;
+  ut->slot = slot;
+  ut->status = -1;
+  ut->exited = false;
+  ut->joining = false;
+  list_push_back (&group->threads, &ut->elem);
+
+  /* The initial frame: a null return address and the two
+     arguments.  Writing it may fault the page in. */
+  esp = (uint32_t *) stack_top (slot) - 3;
+  esp[0] = 0;
+  esp[1] = (uint32_t) arg0;
+  esp[2] = (uint32_t) arg1;
+
+  info.leader = leader;
+  info.self = ut;
+  info.eip = start;
+  info.esp = esp;
+  sema_init (&info.started, 0);
+  ut->tid = thread_create (thread_name (), PRI_DEFAULT, start_uthread, &info);
+  if (ut->tid == TID_ERROR)
+    {
+      group->stacks &= ~(1u << slot);
+      group->live--;
+      list_remove (&ut->elem);
+      lock_release (&group->lock);
+      free (ut);
+      return TID_ERROR;
+    }
+  lock_release (&group->lock);
+  sema_down (&info.started);
+  return ut->tid;
+}
+
+/* Terminates the current thread with STATUS, which
+   uthread_join() returns.  In the leader, the status is
+   ignored. */
+void
+uthread_exit (int status)
+{
+  struct uthread *ut = thread_current ()->uthread;
+
+  if (ut != NULL)
+    ut->status = status;
+  thread_exit ();
+}
+
+/* Terminates the current process with STATUS, unless it is
+   already exiting with another status, and then the current
+   thread.  The process's other threads follow at their next
+   system call or return to user mode; its futex sleepers are
+   woken for them to do so. */
+void
+uthread_exit_process (int status)
+{
+  struct thread *leader = thread_current ()->leader;
+  struct uthread_group *group = &leader->uthreads;
+
+  lock_acquire (&group->lock);
+  if (!group->dying)
+    {
+      group->dying = true;
+      leader->exit_status = status;
+    }
+  lock_release (&group->lock);
+
+  futex_wake_all (leader->pagedir);
+  thread_exit ();
+}
+
+/* Returns true if the current thread's process is exiting, in
+   which case the thread must not go back to user mode. */
+bool
+uthread_dying (void)
+{
+  return thread_current ()->leader->uthreads.dying;
+}
+
+/* Waits for thread TID of the current process to exit, and
+   frees its stack slot.  Returns its exit status, or -1 if TID
+   is not a thread of the process that may be joined: the
+   leader, the current thread, a thread already joined, or one
+   that another thread is already joining. */
+int
+uthread_join (int tid)
+{
+  struct uthread_group *group = &thread_current ()->leader->uthreads;
+  struct uthread *ut = NULL;
+  struct list_elem *e;
+  int status;
+
+  lock_acquire (&group->lock);
+  for (e = list_begin (&group->threads); e != list_end (&group->threads);
+       e = list_next (e))
+    {
+      struct uthread *u = list_entry (e, struct uthread, elem);
+      if (u->tid == tid)
+        {
+          ut = u;
+          break;
+        }
+    }
+  if (ut == NULL || ut->joining || ut == thread_current ()->uthread)
+    {
+      lock_release (&group->lock);
+      return -1;
+    }
+
+  ut->joining = true;
+  while (!ut->exited)
+    cond_wait (&group->exited, &group->lock);
+  list_remove (&ut->elem);
+  group->stacks &= ~(1u << ut->slot);
+  lock_release (&group->lock);
+
+  status = ut->status;
+  free (ut);
+  return status;
+}
+
+/* Called by process_exit() in a thread other than the leader,
+   once it no longer uses the address space. */
+void
+uthread_exited (void)
+{
+  struct thread *t = thread_current ();
+  struct uthread_group *group = &t->leader->uthreads;
+
+  lock_acquire (&group->lock);
+  t->uthread->exited = true;
+  group->live--;
+  cond_broadcast (&group->exited, &group->lock);
+  lock_release (&group->lock);
+}
+
+/* Called by process_exit() in the leader.  Waits for the other
+   threads of the process to exit, and frees their records. */
+void
+uthread_join_all (void)
+{
+  struct uthread_group *group = &thread_current ()->uthreads;
+
+  lock_acquire (&group->lock);
+  while (group->live > 0)
+    cond_wait (&group->exited, &group->lock);
+  while (!list_empty (&group->threads))
+    free (list_entry (list_pop_front (&group->threads),
+                      struct uthread, elem));
+  group->stacks = 0;
+  lock_release (&group->lock);
+}
@@ -0,0 +1,33 @@
+#ifndef USERPROG_UTHREAD_H
+#define USERPROG_UTHREAD_H
+
+#include <debug.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* The threads of a user process besides its initial one, kept by
+   the initial thread. */
+struct uthread_group
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition exited;    /* Signaled when a thread exits. */
+    struct list threads;        /* struct uthread, not yet joined. */
+    int live;                   /* Threads still running. */
+    bool dying;                 /* Is the whole process exiting? */
+    uint32_t stacks;            /* Bitmap of stack slots in use. */
+  };
+
+struct uthread;
+
+void uthread_group_init (struct uthread_group *);
+int uthread_create (void (*start) (void), void *arg0, void *arg1);
+void uthread_exit (int status) NO_RETURN;
+void uthread_exit_process (int status) NO_RETURN;
+bool uthread_dying (void);
+int uthread_join (int tid);
+void uthread_exited (void);
+void uthread_join_all (void);
+
+#endif /* userprog/uthread.h */
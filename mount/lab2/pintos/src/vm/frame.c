@@ -0,0 +1,335 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/pcache.h"
+
+/* Frame table and page replacement.
+
+   Frames are replaced with WSClock.  All frames sit on a
+   circular list swept by a clock hand, and each remembers when
+   its page was last seen in use, measured in its owner's virtual
+   time: the ticks the owner has spent running (thread_tick()
+   advances it).  A page whose accessed bit is set is in use now;
+   the sweep clears the bit and stamps the frame.  A page not used
+   for longer than the working set window has left its owner's
+   working set and may be replaced.  Measuring age in the owner's
+   own time means a process that sleeps or waits for the CPU does
+   not lose its working set just because others ran meanwhile.
+
+   Every process also keeps a reserve of frame_min_resident frames
+   that the sweep does not take, so one process faulting heavily
+   cannot page every other process out entirely.
+
+   Old clean pages are preferred, since they can be dropped
+   without I/O.  Classic WSClock schedules writes for old dirty
+   pages and keeps sweeping; we have no asynchronous writes, so
+   we settle for the first old dirty page once a full revolution
+   found no clean one.  If nothing is old enough, the page idle
+   longest outside of its owner's reserve goes, and as a last
+   resort any unpinned page.
+
+   Frames of the page cache (vm/pcache.c) share the clock.  They
+   have no owner and are always clean, so they simply get a
+   second chance and are taken when the hand comes back.
+
+   Writing a victim to swap takes a while, so frame_lock is not
+   held across it.  The victim's frame stays pinned, keeping other
+   sweeps off it, and its page is marked as being evicted, so that
+   a fault on the page or the owner freeing it waits on
+   evict_done until the write is over. */
+
+/* -vmwindow: Working set window. */
+int64_t frame_ws_window = 50;
+
+/* -vmreserve: Per-process reserve. */
+int frame_min_resident = 16;
+
+static struct list frames;          /* All frames, in clock order. */
+static struct list_elem *hand;      /* Clock hand, or null. */
+static struct lock frame_lock;      /* Protects all of the above. */
+static struct condition evict_done; /* Signaled when an eviction ends. */
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = NULL;
+  lock_init (&frame_lock);
+  cond_init (&evict_done);
+}
+
+/* Moves the clock hand to the next frame and returns it. */
+static struct frame *
+advance_hand (void)
+{
+  if (hand == NULL || hand == list_end (&frames)
+      || (hand = list_next (hand)) == list_end (&frames))
+    hand = list_begin (&frames);
+  return list_entry (hand, struct frame, elem);
+}
+
+/* Picks a frame to evict with WSClock.  Returns a null pointer
+   if every frame is pinned. */
+static struct frame *
+choose_victim (void)
+{
+  struct frame *old_dirty = NULL;   /* First old, dirty page. */
+  struct frame *idlest = NULL;      /* Oldest page outside a reserve. */
+  int64_t idlest_age = -1;
+  size_t n = list_size (&frames);
+  size_t i;
+  struct list_elem *e;
+
+  /* Two revolutions: pages whose accessed bit the first one
+     clears may be old by the time of the second. */
+  for (i = 0; i < 2 * n; i++)
+    {
+      struct frame *f = advance_hand ();
+      struct page *p = f->page;
+      struct thread *owner;
+      int64_t age;
+
+      if (f->pinned)
+        continue;
+      if (f->cache != NULL)
+        {
+          if (pcache_try_evict (f->cache))
+            return f;
+          continue;
+        }
+      owner = p->owner;
+      if (pagedir_is_accessed (owner->pagedir, p->upage))
+        {
+          pagedir_set_accessed (owner->pagedir, p->upage, false);
+          f->last_use = owner->vm_vtime;
+          continue;
+        }
+      if (owner->vm_resident <= frame_min_resident)
+        continue;
+
+      age = owner->vm_vtime - f->last_use;
+      if (age > frame_ws_window)
+        {
+          if (!page_is_dirty (p))
+            return f;
+          if (old_dirty == NULL)
+            old_dirty = f;
+        }
+      if (age > idlest_age)
+        {
+          idlest = f;
+          idlest_age = age;
+        }
+    }
+  if (old_dirty != NULL)
+    return old_dirty;
+  if (idlest != NULL)
+    return idlest;
+
+  for (e = list_begin (&frames); e != list_end (&frames); e = list_next (e))
+    {
+      struct frame *f = list_entry (e, struct frame, elem);
+      if (!f->pinned && f->page != NULL)
+        return f;
+    }
+  return NULL;
+}
+
+/* Evicts the page in frame F, which choose_victim() picked,
+   dropping frame_lock while page_evict() writes it out.  Returns
+   false, leaving F as it was, if swap is full.  The caller must
+   hold frame_lock. */
+static bool
+evict_page (struct frame *f)
+{
+  struct page *victim = f->page;
+  bool evicted;
+
+  f->pinned = true;
+  victim->evicting = true;
+  lock_release (&frame_lock);
+  evicted = page_evict (victim);
+  lock_acquire (&frame_lock);
+  victim->evicting = false;
+  if (evicted)
+    {
+      victim->frame = NULL;
+      victim->owner->vm_resident--;
+    }
+  else
+    f->pinned = false;
+  cond_broadcast (&evict_done, &frame_lock);
+  return evicted;
+}
+
+/* Waits for PAGE to finish being evicted, if it is.  The caller
+   must hold frame_lock. */
+static void
+wait_for_eviction (const struct page *page)
+{
+  while (page->evicting)
+    cond_wait (&evict_done, &frame_lock);
+}
+
+/* Returns a frame for PAGE of the current process, or else for
+   page cache page CACHE, evicting another page if the user pool
+   is exhausted and EVICT is true.  The frame is pinned until
+   frame_unpin().  Returns a null pointer if no frame could be
+   had. */
+static struct frame *
+alloc_frame (struct page *page, struct pcache_page *cache, bool evict)
+{
+  struct frame *f;
+  void *kpage;
+
+  lock_acquire (&frame_lock);
+  kpage = palloc_get_page (PAL_USER);
+  if (kpage != NULL)
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          lock_release (&frame_lock);
+          return NULL;
+        }
+      f->kpage = kpage;
+      list_push_back (&frames, &f->elem);
+    }
+  else
+    {
+      /* A page cache victim is already evicted. */
+      f = evict ? choose_victim () : NULL;
+      if (f == NULL || (f->page != NULL && !evict_page (f)))
+        {
+          lock_release (&frame_lock);
+          return NULL;
+        }
+    }
+
+  f->page = page;
+  f->cache = cache;
+  f->pinned = true;
+  f->last_use = 0;
+  if (page != NULL)
+    {
+      f->last_use = page->owner->vm_vtime;
+      page->frame = f;
+      page->owner->vm_resident++;
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Returns a frame for PAGE of the current process, evicting
+   another page if need be.  The frame is pinned until
+   frame_unpin().  Returns a null pointer if no frame could be
+   had. */
+struct frame *
+frame_alloc (struct page *page)
+{
+  return alloc_frame (page, NULL, true);
+}
+
+/* Like frame_alloc(), but only takes a free frame, for pages
+   that are merely likely to be used. */
+struct frame *
+frame_try_alloc (struct page *page)
+{
+  return alloc_frame (page, NULL, false);
+}
+
+/* Returns a pinned frame for page cache page CACHE, evicting
+   another page if need be and EVICT is true. */
+struct frame *
+frame_alloc_cache (struct pcache_page *cache, bool evict)
+{
+  return alloc_frame (NULL, cache, evict);
+}
+
+/* Keeps PAGE's frame, if it has one, from being evicted until
+   frame_unpin() or frame_free().  Returns the frame, or a null
+   pointer if PAGE is not in a frame. */
+struct frame *
+frame_pin (struct page *page)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (page);
+  f = page->frame;
+  if (f != NULL)
+    f->pinned = true;
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Allows frame F to be evicted. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  f->pinned = false;
+  lock_release (&frame_lock);
+}
+
+/* Removes F from the clock and frees it.  The caller must hold
+   frame_lock. */
+static void
+release_frame (struct frame *f)
+{
+  if (hand == &f->elem)
+    hand = list_prev (hand);
+  list_remove (&f->elem);
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Unmaps PAGE and frees its frame, if it has one. */
+void
+frame_free (struct page *page)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (page);
+  f = page->frame;
+  if (f != NULL)
+    {
+      pagedir_clear_page (page->owner->pagedir, page->upage);
+      page->owner->vm_resident--;
+      page->frame = NULL;
+      release_frame (f);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Frees the frame of page cache page CACHE. */
+void
+frame_free_cache (struct pcache_page *cache)
+{
+  lock_acquire (&frame_lock);
+  release_frame (cache->frame);
+  cache->frame = NULL;
+  lock_release (&frame_lock);
+}
+
+/* Returns true if PAGE is in a frame.  A page on its way out of
+   its frame is waited for and then is not. */
+bool
+frame_is_resident (const struct page *page)
+{
+  bool resident;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (page);
+  resident = page->frame != NULL;
+  lock_release (&frame_lock);
+  return resident;
+}
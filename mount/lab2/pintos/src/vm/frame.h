@@ -0,0 +1,39 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct page;
+struct pcache_page;
+
+/* A frame of the user pool holding a page of some process. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct page *page;          /* Process page it holds, or null. */
+    struct pcache_page *cache;  /* Or the page cache page it holds. */
+    bool pinned;                /* Not to be evicted? */
+    int64_t last_use;           /* Owner's virtual time of last use. */
+    struct list_elem elem;      /* Element in the clock list. */
+  };
+
+/* -vmwindow: Working set window, in ticks of the owner's
+   virtual time. */
+extern int64_t frame_ws_window;
+
+/* -vmreserve: Frames no process is pushed below. */
+extern int frame_min_resident;
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *);
+struct frame *frame_try_alloc (struct page *);
+struct frame *frame_alloc_cache (struct pcache_page *, bool evict);
+struct frame *frame_pin (struct page *);
+void frame_unpin (struct frame *);
+void frame_free (struct page *);
+void frame_free_cache (struct pcache_page *);
+bool frame_is_resident (const struct page *);
+
+#endif /* vm/frame.h */
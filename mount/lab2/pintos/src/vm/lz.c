@@ -0,0 +1,204 @@
+#include "vm/lz.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+
+/* A compressor for the LZ4 block format, tuned for speed over
+   ratio: it takes the first match a small hash table offers and
+   never searches further.
+
+   A block is a sequence of sequences.  Each starts with a token
+   byte whose high nibble is the number of literal bytes that
+   follow and whose low nibble is the match length minus
+   MIN_MATCH.  A nibble of 15 continues in the following bytes,
+   each added to it, until one is less than 255.  After the
+   literals comes the match: a 2-byte little-endian offset back
+   into the output, then the continued match length.  The last
+   sequence has only literals.  As in LZ4, the last LAST_LITERALS
+   bytes are always literals and no match starts in the last
+   MF_LIMIT bytes.
+
+   Not thread-safe: the hash table is shared. */
+
+#define MIN_MATCH 4             /* Shortest match. */
+#define LAST_LITERALS 5         /* Bytes at the end always literal. */
+#define MF_LIMIT 12             /* No match starts this close to the end. */
+#define HASH_BITS 12            /* Log2 of hash table entries. */
+
+/* Position in the input last seen with each hash. */
+static uint16_t hash_table[1 << HASH_BITS];
+
+/* Returns the 4 bytes at P. */
+static inline uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return v;
+}
+
+/* Hashes the 4 bytes V. */
+static inline unsigned
+hash4 (uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Appends the continuation bytes of length N to OP. */
+static uint8_t *
+put_length (uint8_t *op, size_t n)
+{
+  for (; n >= 255; n -= 255)
+    *op++ = 255;
+  *op++ = n;
+  return op;
+}
+
+/* Appends to OP a sequence of LIT_LEN literals from LIT followed,
+   if MATCH_LEN is nonzero, by a match of MATCH_LEN bytes OFFSET
+   bytes back.  Returns the new end of the output, or a null
+   pointer if it would go past OEND. */
+static uint8_t *
+put_sequence (uint8_t *op, uint8_t *oend, const uint8_t *lit,
+              size_t lit_len, size_t offset, size_t match_len)
+{
+  size_t ml = match_len > 0 ? match_len - MIN_MATCH : 0;
+  uint8_t *token;
+
+  /* Worst case: token, literal and match lengths, literals,
+     offset. */
+  if ((size_t) (oend - op) < 1 + lit_len / 255 + 1 + lit_len + 2
+                              + ml / 255 + 1)
+    return NULL;
+
+  token = op++;
+  *token = (lit_len >= 15 ? 15 : lit_len) << 4;
+  if (lit_len >= 15)
+    op = put_length (op, lit_len - 15);
+  memcpy (op, lit, lit_len);
+  op += lit_len;
+
+  if (match_len > 0)
+    {
+      *op++ = offset & 0xff;
+      *op++ = offset >> 8;
+      *token |= ml >= 15 ? 15 : ml;
+      if (ml >= 15)
+        op = put_length (op, ml - 15);
+    }
+  return op;
+}
+
+/* Compresses the LEN bytes at SRC into DST, which has room for
+   CAP bytes.  Returns the compressed size, or 0 if it would be
+   more than CAP. */
+size_t
+lz_compress (const void *src_, size_t len, void *dst_, size_t cap)
+{
+  const uint8_t *src = src_;
+  const uint8_t *end = src + len;
+  const uint8_t *mflimit = len > MF_LIMIT ? end - MF_LIMIT : src;
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+
+  ASSERT (len <= LZ_MAX_INPUT);
+
+  memset (hash_table, 0, sizeof hash_table);
+  while (ip < mflimit)
+    {
+      uint32_t v = read32 (ip);
+      unsigned h = hash4 (v);
+      const uint8_t *ref = src + hash_table[h];
+      const uint8_t *mend;
+
+      hash_table[h] = ip - src;
+      if (ref >= ip || read32 (ref) != v)
+        {
+          ip++;
+          continue;
+        }
+
+      /* Extend the match as far as the end allows. */
+      mend = ip + MIN_MATCH;
+      ref += MIN_MATCH;
+      while (mend < end - LAST_LITERALS && *mend == *ref)
+        mend++, ref++;
+
+      op = put_sequence (op, dst + cap, anchor, ip - anchor,
+                         mend - ref, mend - ip);
+      if (op == NULL)
+        return 0;
+      ip = anchor = mend;
+    }
+
+  op = put_sequence (op, dst + cap, anchor, end - anchor, 0, 0);
+  return op != NULL ? (size_t) (op - dst) : 0;
+}
+
+/* Reads continuation bytes at *IP, before IEND, adding them to
+   *N.  Returns false if the input ends first. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *iend, size_t *n)
+{
+  unsigned b;
+
+  do
+    {
+      if (*ip >= iend)
+        return false;
+      b = *(*ip)++;
+      *n += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Decompresses the LEN bytes at SRC into the DST_LEN bytes at
+   DST.  Returns false if SRC is corrupt or does not decompress
+   to exactly DST_LEN bytes. */
+bool
+lz_decompress (const void *src, size_t len, void *dst_, size_t dst_len)
+{
+  const uint8_t *ip = src;
+  const uint8_t *iend = ip + len;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *oend = dst + dst_len;
+
+  while (ip < iend)
+    {
+      unsigned token = *ip++;
+      size_t n = token >> 4;
+      size_t offset;
+      const uint8_t *ref;
+
+      /* Literals. */
+      if (n == 15 && !get_length (&ip, iend, &n))
+        return false;
+      if (n > (size_t) (iend - ip) || n > (size_t) (oend - op))
+        return false;
+      memcpy (op, ip, n);
+      op += n;
+      ip += n;
+      if (ip == iend)
+        break;
+
+      /* Match.  It may overlap its own output, so copy bytewise. */
+      if (iend - ip < 2)
+        return false;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      n = token & 15;
+      if (n == 15 && !get_length (&ip, iend, &n))
+        return false;
+      n += MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || n > (size_t) (oend - op))
+        return false;
+      for (ref = op - offset; n > 0; n--)
+        *op++ = *ref++;
+    }
+  return op == oend;
+}
@@ -0,0 +1,13 @@
+#ifndef VM_LZ_H
+#define VM_LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Largest input lz_compress() accepts. */
+#define LZ_MAX_INPUT 65535
+
+size_t lz_compress (const void *src, size_t len, void *dst, size_t cap);
+bool lz_decompress (const void *src, size_t len, void *dst, size_t dst_len);
+
+#endif /* vm/lz.h */
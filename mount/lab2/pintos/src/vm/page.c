@@ -0,0 +1,567 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/pcache.h"
+#include "vm/swap.h"
+
+/* Maximum size of a process's stack. */
+#define STACK_MAX (8 * 1024 * 1024)
+
+/* How far below the stack pointer an access may be and still
+   grow the stack.  PUSHA writes 32 bytes below it. */
+#define STACK_SLOP 32
+
+/* Fault-around.  A fault on a file page also reads in the file
+   pages that follow it.  The window doubles, up to
+   READ_AHEAD_MAX, each time a fault lands just past the previous
+   window, as in a sequential scan, and drops back to
+   READ_AHEAD_MIN on any other fault.  Pages read ahead only get
+   free frames; nothing is evicted for them. */
+#define READ_AHEAD_MIN 4
+#define READ_AHEAD_MAX 32
+
+/* A page of zeros, mapped read-only for reads of zero pages
+   until they are first written, so that large arrays that are
+   only read or sparsely written take little memory. */
+static void *zero_page;
+
+/* Sets up the shared zero page. */
+void
+page_init (void)
+{
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Initializes the current process's supplemental page table. */
+bool
+page_table_init (void)
+{
+  struct thread *t = thread_current ();
+
+  lock_init (&t->pages_lock);
+  return hash_init (&t->pages, page_hash, page_less, NULL);
+}
+
+/* Frees page P, its frame and its swap slot, first writing it
+   back to its file if it is a mapped page that was modified. */
+static void
+free_page (struct page *p)
+{
+  struct frame *f;
+
+  /* pagedir_destroy() would free the zero page. */
+  if (p->zero_mapped)
+    pagedir_clear_page (p->owner->pagedir, p->upage);
+  pcache_unmap (p);
+  if (p->type == PAGE_MMAP && (f = frame_pin (p)) != NULL
+      && pagedir_is_dirty (p->owner->pagedir, p->upage))
+    file_write_at (p->file, f->kpage, p->read_bytes, p->ofs);
+  frame_free (p);
+  if (p->type == PAGE_SWAP && p->swap_slot != SWAP_ERROR)
+    swap_free (p->swap_slot);
+  free (p);
+}
+
+/* Releases a page's frame and swap slot. */
+static void
+destroy_page (struct hash_elem *e, void *aux UNUSED)
+{
+  free_page (hash_entry (e, struct page, hash_elem));
+}
+
+/* Destroys the current process's supplemental page table,
+   unmapping and freeing every page in it.  Must be called while
+   the page directory still exists. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&thread_current ()->pages, destroy_page);
+}
+
+/* Returns the current process's page at UPAGE, or a null
+   pointer if there is none.  The caller must hold the process's
+   pages_lock. */
+static struct page *
+find_page (const void *upage)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = (void *) upage;
+  e = hash_find (&thread_current ()->leader->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Returns the current process's page at UPAGE, or a null
+   pointer if there is none. */
+struct page *
+page_lookup (const void *upage)
+{
+  struct lock *lock = &thread_current ()->leader->pages_lock;
+  struct page *p;
+
+  lock_acquire (lock);
+  p = find_page (upage);
+  lock_release (lock);
+  return p;
+}
+
+/* Adds a page of TYPE at UPAGE to the current process's page
+   table.  Returns the page, or a null pointer if UPAGE is
+   already in use or memory is short.  The caller must hold the
+   process's pages_lock. */
+static struct page *
+page_add (void *upage, bool writable, enum page_type type)
+{
+  struct thread *t = thread_current ()->leader;
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->writable = writable;
+  p->type = type;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  p->swap_slot = SWAP_ERROR;
+  p->frame = NULL;
+  p->evicting = false;
+  p->zero_mapped = false;
+  p->cached = NULL;
+  p->owner = t;
+  if (hash_insert (&t->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds a zero-filled page at UPAGE.  Nothing is allocated until
+   it is first touched. */
+struct page *
+page_add_zero (void *upage, bool writable)
+{
+  struct lock *lock = &thread_current ()->leader->pages_lock;
+  struct page *p;
+
+  lock_acquire (lock);
+  p = page_add (upage, writable, PAGE_ZERO);
+  lock_release (lock);
+  return p;
+}
+
+/* Adds a page at UPAGE that starts out as READ_BYTES bytes read
+   from FILE at OFS followed by zeros.  FILE must stay open for
+   as long as the page exists. */
+struct page *
+page_add_file (void *upage, bool writable, struct file *file, off_t ofs,
+               size_t read_bytes)
+{
+  struct lock *lock = &thread_current ()->leader->pages_lock;
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  lock_acquire (lock);
+  p = page_add (upage, writable, PAGE_FILE);
+  if (p != NULL)
+    {
+      p->file = file;
+      p->ofs = ofs;
+      p->read_bytes = read_bytes;
+    }
+  lock_release (lock);
+  return p;
+}
+
+/* Removes the current process's pages from UPAGE up to END,
+   writing back mapped pages that were modified.  The caller must
+   hold the process's pages_lock. */
+static void
+remove_pages (uint8_t *upage, const uint8_t *end)
+{
+  struct thread *t = thread_current ()->leader;
+
+  for (; upage < end; upage += PGSIZE)
+    {
+      struct page *p = find_page (upage);
+
+      if (p != NULL)
+        {
+          hash_delete (&t->pages, &p->hash_elem);
+          free_page (p);
+        }
+    }
+}
+
+/* Maps the LENGTH bytes of FILE at ADDR, which must be page
+   aligned.  The pages are read from FILE as they are touched and
+   written back to it when they are evicted or unmapped, if they
+   were modified.  FILE must stay open until page_unmap_file().
+   Returns false, mapping nothing, if the pages would overlap
+   pages already in use or leave user memory, or if memory is
+   short. */
+bool
+page_map_file (void *addr, struct file *file, off_t length)
+{
+  struct lock *lock = &thread_current ()->leader->pages_lock;
+  uint8_t *start = addr;
+  uint8_t *end = start + ROUND_UP (length, PGSIZE);
+  uint8_t *upage;
+  bool success = true;
+
+  ASSERT (pg_ofs (addr) == 0);
+  ASSERT (length > 0);
+
+  if (end <= start || !is_user_vaddr (end - 1))
+    return false;
+
+  lock_acquire (lock);
+  for (upage = start; upage < end && success; upage += PGSIZE)
+    success = find_page (upage) == NULL;
+  for (upage = start; upage < end && success; upage += PGSIZE)
+    {
+      off_t ofs = upage - start;
+      struct page *p = page_add (upage, true, PAGE_MMAP);
+
+      if (p == NULL)
+        {
+          remove_pages (start, upage);
+          success = false;
+          break;
+        }
+      p->file = file;
+      p->ofs = ofs;
+      p->read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+    }
+  lock_release (lock);
+  return success;
+}
+
+/* Unmaps the LENGTH bytes mapped at ADDR by page_map_file(),
+   writing back the pages that were modified. */
+void
+page_unmap_file (void *addr, off_t length)
+{
+  struct lock *lock = &thread_current ()->leader->pages_lock;
+
+  lock_acquire (lock);
+  remove_pages (addr, (uint8_t *) addr + ROUND_UP (length, PGSIZE));
+  lock_release (lock);
+}
+
+/* Returns true if an access to ADDR with the stack pointer at
+   ESP should grow the stack. */
+static bool
+is_stack_access (const void *addr, const void *esp)
+{
+  return (esp != NULL
+          && (const uint8_t *) addr >= (uint8_t *) PHYS_BASE - STACK_MAX
+          && (const uint8_t *) addr + STACK_SLOP >= (const uint8_t *) esp);
+}
+
+/* Reads file page P into KPAGE.  Returns false if the file is
+   too short. */
+static bool
+read_file_page (const struct page *p, void *kpage)
+{
+  if (file_read_at (p->file, kpage, p->read_bytes, p->ofs)
+      != (off_t) p->read_bytes)
+    return false;
+  memset ((uint8_t *) kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+  return true;
+}
+
+/* Fills frame F with the contents of page P.  Sets *SOURCE to
+   where they came from and *MAJOR to whether that took I/O.
+   Returns false if the contents could not be read. */
+static bool
+load_page (struct page *p, struct frame *f, enum vm_fault_source *source,
+           bool *major)
+{
+  switch (p->type)
+    {
+    case PAGE_ZERO:
+      memset (f->kpage, 0, PGSIZE);
+      *source = VM_FAULT_ZERO;
+      *major = false;
+      return true;
+
+    case PAGE_FILE:
+    case PAGE_MMAP:
+      if (!read_file_page (p, f->kpage))
+        return false;
+      *source = VM_FAULT_FILE;
+      *major = true;
+      return true;
+
+    case PAGE_SWAP:
+      /* The frame is now the only copy, so page_is_dirty()
+         treats it as modified. */
+      *major = swap_in (p->swap_slot, f->kpage);
+      swap_free (p->swap_slot);
+      p->swap_slot = SWAP_ERROR;
+      vm_stats_swap_read (p->owner);
+      *source = VM_FAULT_SWAP;
+      return true;
+    }
+  NOT_REACHED ();
+}
+
+/* Returns true if file page P can map the page cache's copy of
+   its data instead of getting a frame of its own: it must be
+   read-only and cover a whole page of the file. */
+static bool
+is_shareable (const struct page *p)
+{
+  return (p->type == PAGE_FILE && !p->writable && p->read_bytes == PGSIZE
+          && p->ofs % PGSIZE == 0);
+}
+
+/* Maps shareable page P to the page cache's copy, evicting
+   another page for it only if EVICT is true.  Sets *MISS, if
+   non-null, to whether the data had to be read. */
+static bool
+map_cached (struct page *p, bool evict, bool *miss)
+{
+  struct pcache_page *cp;
+  bool success;
+
+  cp = pcache_get (file_get_inode (p->file), p->ofs / PGSIZE, evict, miss);
+  if (cp == NULL)
+    return false;
+  success = pcache_map (cp, p);
+  pcache_put (cp);
+  return success;
+}
+
+/* Reads in and maps the file pages following P, which was just
+   faulted in, sizing the window as described at the top. */
+static void
+read_ahead (const struct page *p)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = p->upage;
+  unsigned long pages = 0;
+  int i;
+
+  if (upage == t->ra_next)
+    t->ra_window = (t->ra_window * 2 < READ_AHEAD_MAX
+                    ? t->ra_window * 2 : READ_AHEAD_MAX);
+  else
+    t->ra_window = READ_AHEAD_MIN;
+
+  for (i = 1; i <= t->ra_window; i++)
+    {
+      struct page *q = find_page (upage + i * PGSIZE);
+      struct frame *f;
+
+      /* Stop at the end of the run of pages from P's file. */
+      if (q == NULL || q->type != p->type || q->file != p->file
+          || q->ofs != p->ofs + i * PGSIZE)
+        break;
+      if (frame_is_resident (q) || pcache_is_mapped (q))
+        continue;
+      if (is_shareable (q))
+        {
+          if (!map_cached (q, false, NULL))
+            break;
+          pages++;
+          continue;
+        }
+
+      f = frame_try_alloc (q);
+      if (f == NULL)
+        break;
+      if (!read_file_page (q, f->kpage)
+          || !pagedir_set_page (t->pagedir, q->upage, f->kpage, q->writable))
+        {
+          frame_free (q);
+          break;
+        }
+      frame_unpin (f);
+      pages++;
+    }
+  t->ra_next = upage + i * PGSIZE;
+  if (pages > 0)
+    vm_stats_read_ahead (t->leader, pages);
+}
+
+/* Does the work of page_fault_in(), with the process's
+   pages_lock held. */
+static bool
+fault_in (const void *fault_addr, bool write, const void *esp,
+          enum vm_fault_source *source, bool *major)
+{
+  struct thread *t = thread_current ();
+  void *upage = pg_round_down (fault_addr);
+  struct page *p;
+  struct frame *f;
+
+  p = find_page (upage);
+  if (p == NULL)
+    {
+      if (!is_stack_access (fault_addr, esp))
+        return false;
+      p = page_add (upage, true, PAGE_ZERO);
+      if (p == NULL)
+        return false;
+    }
+  else if (p->zero_mapped)
+    {
+      /* A write to the shared zero page. */
+      if (!write || !p->writable)
+        return false;
+      pagedir_clear_page (t->pagedir, upage);
+      p->zero_mapped = false;
+    }
+  else if (frame_is_resident (p) || pcache_is_mapped (p))
+    {
+      /* Another thread of the process brought it in first, unless
+         this is a write to a read-only page. */
+      *source = (p->type == PAGE_FILE || p->type == PAGE_MMAP ? VM_FAULT_FILE
+                 : p->type == PAGE_SWAP ? VM_FAULT_SWAP : VM_FAULT_ZERO);
+      *major = false;
+      return !write || p->writable;
+    }
+
+  if (p->type == PAGE_ZERO && !write)
+    {
+      if (!pagedir_set_page (t->pagedir, upage, zero_page, false))
+        return false;
+      p->zero_mapped = true;
+      *source = VM_FAULT_ZERO;
+      *major = false;
+      return true;
+    }
+
+  if (is_shareable (p))
+    {
+      if (!map_cached (p, true, major))
+        return false;
+      *source = VM_FAULT_FILE;
+      read_ahead (p);
+      return true;
+    }
+
+  f = frame_alloc (p);
+  if (f == NULL)
+    return false;
+  if (!load_page (p, f, source, major)
+      || !pagedir_set_page (t->pagedir, upage, f->kpage, p->writable))
+    {
+      frame_free (p);
+      return false;
+    }
+  frame_unpin (f);
+
+  if (p->type == PAGE_FILE || p->type == PAGE_MMAP)
+    read_ahead (p);
+  return true;
+}
+
+/* Brings in the current process's page containing FAULT_ADDR,
+   growing the stack if the access is just below user stack
+   pointer ESP (null if unknown).  WRITE tells whether the access
+   was a write; reads of zero pages get the shared zero page, and
+   the first write to one replaces it with a frame of its own.
+   Sets *SOURCE and *MAJOR as the paging statistics want them.
+   Returns false if FAULT_ADDR is not a valid address to fault
+   in.
+
+   The threads of a process fault one at a time. */
+bool
+page_fault_in (const void *fault_addr, bool write, const void *esp,
+               enum vm_fault_source *source, bool *major)
+{
+  struct thread *t = thread_current ();
+  bool success;
+
+  if (t->pagedir == NULL || !is_user_vaddr (fault_addr))
+    return false;
+
+  lock_acquire (&t->leader->pages_lock);
+  success = fault_in (fault_addr, write, esp, source, major);
+  lock_release (&t->leader->pages_lock);
+  return success;
+}
+
+/* Returns true if page P's frame holds data that exists
+   nowhere else. */
+bool
+page_is_dirty (const struct page *p)
+{
+  return (p->type == PAGE_SWAP
+          || pagedir_is_dirty (p->owner->pagedir, p->upage));
+}
+
+/* Unmaps page P from its frame, writing it to swap first if it
+   is dirty, or back to its file if it is a mapped page.  Called
+   by the frame table without its lock, so that other faults need
+   not wait for the write, but with P's frame pinned and P marked
+   as being evicted, which keeps the owner from faulting the page
+   back in or freeing it meanwhile.  The frame table clears P's
+   frame once this returns.  Returns false, leaving P mapped, if
+   swap is full. */
+bool
+page_evict (struct page *p)
+{
+  struct thread *owner = p->owner;
+  bool dirty;
+
+  ASSERT (p->frame != NULL);
+
+  /* Unmap first so the owner can't modify the page after we
+     have decided whether it is dirty.  Clearing the present bit
+     leaves the dirty bit alone. */
+  pagedir_clear_page (owner->pagedir, p->upage);
+  dirty = page_is_dirty (p);
+  if (dirty && p->type == PAGE_MMAP)
+    file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+  else if (dirty)
+    {
+      size_t slot = swap_out (p->frame->kpage);
+      if (slot == SWAP_ERROR)
+        {
+          pagedir_set_page (owner->pagedir, p->upage, p->frame->kpage,
+                            p->writable);
+          pagedir_set_dirty (owner->pagedir, p->upage, true);
+          return false;
+        }
+      p->type = PAGE_SWAP;
+      p->swap_slot = slot;
+      vm_stats_swap_write (owner);
+    }
+  vm_stats_evict (owner, dirty);
+  return true;
+}
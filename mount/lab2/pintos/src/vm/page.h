@@ -0,0 +1,63 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/stats.h"
+
+/* Where a page's contents live while it is not in a frame. */
+enum page_type
+  {
+    PAGE_ZERO,                  /* Nowhere, it reads as zeros. */
+    PAGE_FILE,                  /* In a file, e.g. the executable. */
+    PAGE_MMAP,                  /* In a mapped file, written back to it. */
+    PAGE_SWAP                   /* In swap, or only in its frame. */
+  };
+
+/* A page of a process's virtual address space, an entry in its
+   supplemental page table. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    bool writable;              /* Mapped writable? */
+    enum page_type type;        /* Backing store. */
+
+    /* PAGE_FILE, PAGE_MMAP: READ_BYTES bytes at OFS in FILE, then
+       zeros. */
+    struct file *file;
+    off_t ofs;
+    size_t read_bytes;
+
+    /* PAGE_SWAP: swap slot, SWAP_ERROR while only in the frame. */
+    size_t swap_slot;
+
+    struct frame *frame;        /* Frame holding it, or null. */
+    bool evicting;              /* Being written out of FRAME? */
+    bool zero_mapped;           /* Mapped to the shared zero page? */
+    struct pcache_page *cached; /* Page cache page it maps, or null. */
+    struct list_elem cache_elem; /* Element in cached->mappers. */
+    struct thread *owner;       /* Process it belongs to. */
+    struct hash_elem hash_elem; /* Element in owner's page table. */
+  };
+
+void page_init (void);
+bool page_table_init (void);
+void page_table_destroy (void);
+
+struct page *page_lookup (const void *upage);
+struct page *page_add_zero (void *upage, bool writable);
+struct page *page_add_file (void *upage, bool writable, struct file *,
+                            off_t ofs, size_t read_bytes);
+
+bool page_map_file (void *addr, struct file *, off_t length);
+void page_unmap_file (void *addr, off_t length);
+
+bool page_fault_in (const void *fault_addr, bool write, const void *esp,
+                    enum vm_fault_source *, bool *major);
+bool page_is_dirty (const struct page *);
+bool page_evict (struct page *);
+
+#endif /* vm/page.h */
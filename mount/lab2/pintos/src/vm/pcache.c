@@ -0,0 +1,386 @@
+#include "vm/pcache.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Page cache.
+
+   File data lives in page-sized frames indexed by inode and page
+   number.  inode_read_at() copies out of them, and read-only
+   pages of executables map them directly, so a file that is both
+   read and executed is in memory once, and several processes
+   running one program share its code.
+
+   Cache frames sit in the frame table like any other, and are
+   always clean, since inode_write_at() writes through to disk
+   and updates the cached copy.  When the clock hand reaches one
+   it gets a second chance if it was read or any process touched
+   it since the last pass, and otherwise is unmapped from every
+   process and reused.
+
+   Lock order: the frame table's lock, then pcache_lock.  The
+   frame table calls pcache_try_evict() with its lock held, so
+   nothing here calls into the frame table with pcache_lock
+   held. */
+
+static struct hash cache;       /* All cached pages. */
+static struct lock pcache_lock; /* Protects cache and its pages. */
+
+/* Statistics. */
+static unsigned long hits;      /* Lookups that found the page. */
+static unsigned long misses;    /* Lookups that read it in. */
+static unsigned long evictions; /* Pages reclaimed by the frame table. */
+
+static unsigned
+pcache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct pcache_page *cp = hash_entry (e, struct pcache_page, hash_elem);
+  return hash_int (cp->inumber) ^ hash_int (cp->index);
+}
+
+static bool
+pcache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct pcache_page *a = hash_entry (a_, struct pcache_page, hash_elem);
+  const struct pcache_page *b = hash_entry (b_, struct pcache_page, hash_elem);
+  if (a->inumber != b->inumber)
+    return a->inumber < b->inumber;
+  return a->index < b->index;
+}
+
+/* Initializes the page cache. */
+void
+pcache_init (void)
+{
+  hash_init (&cache, pcache_hash, pcache_less, NULL);
+  lock_init (&pcache_lock);
+}
+
+/* Returns the cached page INDEX of inode INUMBER, or a null
+   pointer.  The caller must hold pcache_lock. */
+static struct pcache_page *
+lookup (block_sector_t inumber, size_t index)
+{
+  struct pcache_page cp;
+  struct hash_elem *e;
+
+  cp.inumber = inumber;
+  cp.index = index;
+  e = hash_find (&cache, &cp.hash_elem);
+  return e != NULL ? hash_entry (e, struct pcache_page, hash_elem) : NULL;
+}
+
+/* Returns page INDEX of INODE, reading it in if it is not
+   cached, and pins it until pcache_put().  Evicts another page
+   to make room only if EVICT is true.  Sets *MISS, if non-null,
+   to whether the page had to be read.  Returns a null pointer if
+   the page is past the end of the file or no frame is free. */
+struct pcache_page *
+pcache_get (struct inode *inode, size_t index, bool evict, bool *miss)
+{
+  block_sector_t inumber = inode_get_inumber (inode);
+  off_t ofs = (off_t) index * PGSIZE;
+  off_t len = inode_length (inode) - ofs;
+  struct pcache_page *cp, *other;
+
+  if (miss != NULL)
+    *miss = false;
+  if (len <= 0)
+    return NULL;
+  if (len > PGSIZE)
+    len = PGSIZE;
+
+  lock_acquire (&pcache_lock);
+  cp = lookup (inumber, index);
+  if (cp != NULL)
+    {
+      cp->pin_cnt++;
+      hits++;
+      lock_release (&pcache_lock);
+      return cp;
+    }
+  lock_release (&pcache_lock);
+
+  /* Read the page into a frame of its own, without holding
+     pcache_lock, which evicting a page may need. */
+  cp = malloc (sizeof *cp);
+  if (cp == NULL)
+    return NULL;
+  cp->inumber = inumber;
+  cp->index = index;
+  cp->pin_cnt = 1;
+  cp->referenced = false;
+  cp->dead = false;
+  list_init (&cp->mappers);
+  cp->frame = frame_alloc_cache (cp, evict);
+  if (cp->frame == NULL)
+    {
+      free (cp);
+      return NULL;
+    }
+  if (inode_read_uncached (inode, cp->frame->kpage, len, ofs) != len)
+    {
+      frame_free_cache (cp);
+      free (cp);
+      return NULL;
+    }
+  memset ((uint8_t *) cp->frame->kpage + len, 0, PGSIZE - len);
+
+  lock_acquire (&pcache_lock);
+  other = lookup (inumber, index);
+  if (other != NULL)
+    {
+      /* Someone else read it in meanwhile. */
+      other->pin_cnt++;
+      hits++;
+      lock_release (&pcache_lock);
+      frame_free_cache (cp);
+      free (cp);
+      return other;
+    }
+  hash_insert (&cache, &cp->hash_elem);
+  misses++;
+  lock_release (&pcache_lock);
+
+  frame_unpin (cp->frame);
+  if (miss != NULL)
+    *miss = true;
+  return cp;
+}
+
+/* Unpins CP, which was returned by pcache_get(). */
+void
+pcache_put (struct pcache_page *cp)
+{
+  lock_acquire (&pcache_lock);
+  ASSERT (cp->pin_cnt > 0);
+  cp->pin_cnt--;
+  cp->referenced = true;
+  lock_release (&pcache_lock);
+}
+
+/* Maps CP, which the caller has pinned, read-only at page P of
+   P's owner.  Returns false if memory is short. */
+bool
+pcache_map (struct pcache_page *cp, struct page *p)
+{
+  bool success;
+
+  lock_acquire (&pcache_lock);
+  success = pagedir_set_page (p->owner->pagedir, p->upage,
+                              cp->frame->kpage, false);
+  if (success)
+    {
+      list_push_back (&cp->mappers, &p->cache_elem);
+      p->cached = cp;
+    }
+  lock_release (&pcache_lock);
+  return success;
+}
+
+/* Unmaps P from the page cache page it maps, if any. */
+void
+pcache_unmap (struct page *p)
+{
+  lock_acquire (&pcache_lock);
+  if (p->cached != NULL)
+    {
+      list_remove (&p->cache_elem);
+      pagedir_clear_page (p->owner->pagedir, p->upage);
+      p->cached = NULL;
+    }
+  lock_release (&pcache_lock);
+}
+
+/* Returns true if P maps a page cache page. */
+bool
+pcache_is_mapped (const struct page *p)
+{
+  bool mapped;
+
+  lock_acquire (&pcache_lock);
+  mapped = p->cached != NULL;
+  lock_release (&pcache_lock);
+  return mapped;
+}
+
+/* Returns true if CP was read or any of its mappers touched it
+   since the last call, clearing the marks.  The caller must hold
+   pcache_lock. */
+static bool
+test_and_clear_referenced (struct pcache_page *cp)
+{
+  bool referenced = cp->referenced;
+  struct list_elem *e;
+
+  cp->referenced = false;
+  for (e = list_begin (&cp->mappers); e != list_end (&cp->mappers);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, cache_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          referenced = true;
+        }
+    }
+  return referenced;
+}
+
+/* Called by the frame table, with its lock held, when the clock
+   hand reaches CP's frame.  Unmaps CP everywhere and drops it
+   from the cache, unless it is pinned or was referenced since
+   the last pass.  Returns true if CP's frame may be reused. */
+bool
+pcache_try_evict (struct pcache_page *cp)
+{
+  bool evicted = false;
+
+  lock_acquire (&pcache_lock);
+  if (!cp->dead && cp->pin_cnt == 0 && !test_and_clear_referenced (cp))
+    {
+      while (!list_empty (&cp->mappers))
+        {
+          struct page *p = list_entry (list_pop_front (&cp->mappers),
+                                       struct page, cache_elem);
+          pagedir_clear_page (p->owner->pagedir, p->upage);
+          p->cached = NULL;
+        }
+      hash_delete (&cache, &cp->hash_elem);
+      evictions++;
+      evicted = true;
+    }
+  lock_release (&pcache_lock);
+
+  if (evicted)
+    free (cp);
+  return evicted;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at OFFSET,
+   through the cache.  Returns the number of bytes read, which
+   is less than SIZE at end of file or on error. */
+off_t
+pcache_read (struct inode *inode, void *buffer_, off_t size, off_t offset)
+{
+  uint8_t *buffer = buffer_;
+  off_t length = inode_length (inode);
+  off_t bytes_read = 0;
+
+  while (size > 0 && offset < length)
+    {
+      /* Page to read, starting byte offset within page. */
+      size_t index = offset / PGSIZE;
+      int page_ofs = offset % PGSIZE;
+
+      /* Bytes left in inode, bytes left in page, lesser of the two. */
+      off_t inode_left = length - offset;
+      int page_left = PGSIZE - page_ofs;
+      int min_left = inode_left < page_left ? inode_left : page_left;
+
+      /* Number of bytes to actually copy out of this page. */
+      int chunk_size = size < min_left ? size : min_left;
+      struct pcache_page *cp = pcache_get (inode, index, true, NULL);
+
+      if (cp != NULL)
+        {
+          memcpy (buffer + bytes_read,
+                  (uint8_t *) cp->frame->kpage + page_ofs, chunk_size);
+          pcache_put (cp);
+        }
+      else if (inode_read_uncached (inode, buffer + bytes_read, chunk_size,
+                                    offset) != chunk_size)
+        break;
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+  return bytes_read;
+}
+
+/* Copies the SIZE bytes at BUFFER, just written to INODE at
+   OFFSET, into the pages of INODE that are cached. */
+void
+pcache_write (struct inode *inode, const void *buffer_, off_t size,
+              off_t offset)
+{
+  const uint8_t *buffer = buffer_;
+  block_sector_t inumber = inode_get_inumber (inode);
+
+  lock_acquire (&pcache_lock);
+  while (size > 0)
+    {
+      int page_ofs = offset % PGSIZE;
+      int page_left = PGSIZE - page_ofs;
+      int chunk_size = size < page_left ? size : page_left;
+      struct pcache_page *cp = lookup (inumber, offset / PGSIZE);
+
+      if (cp != NULL)
+        memcpy ((uint8_t *) cp->frame->kpage + page_ofs, buffer, chunk_size);
+      size -= chunk_size;
+      offset += chunk_size;
+      buffer += chunk_size;
+    }
+  lock_release (&pcache_lock);
+}
+
+/* Drops every cached page of inode INUMBER, which is being
+   deleted.  None may be mapped. */
+void
+pcache_drop (block_sector_t inumber)
+{
+  struct list doomed;
+  struct hash_iterator i;
+  struct list_elem *e;
+
+  list_init (&doomed);
+  lock_acquire (&pcache_lock);
+  hash_first (&i, &cache);
+  while (hash_next (&i))
+    {
+      struct pcache_page *cp = hash_entry (hash_cur (&i),
+                                           struct pcache_page, hash_elem);
+      if (cp->inumber == inumber)
+        list_push_back (&doomed, &cp->drop_elem);
+    }
+  for (e = list_begin (&doomed); e != list_end (&doomed); e = list_next (e))
+    {
+      struct pcache_page *cp = list_entry (e, struct pcache_page, drop_elem);
+      ASSERT (list_empty (&cp->mappers));
+      hash_delete (&cache, &cp->hash_elem);
+      cp->dead = true;
+    }
+  lock_release (&pcache_lock);
+
+  /* The frame table may still look at a dead page until its frame
+     is gone. */
+  while (!list_empty (&doomed))
+    {
+      struct pcache_page *cp = list_entry (list_pop_front (&doomed),
+                                           struct pcache_page, drop_elem);
+      frame_free_cache (cp);
+      free (cp);
+    }
+}
+
+/* Prints page cache statistics. */
+void
+pcache_print_stats (void)
+{
+  printf ("Page cache: %zu pages, %lu hits, %lu misses, %lu evicted\n",
+          hash_size (&cache), hits, misses, evictions);
+}
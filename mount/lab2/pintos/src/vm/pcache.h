@@ -0,0 +1,42 @@
+#ifndef VM_PCACHE_H
+#define VM_PCACHE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+struct inode;
+struct page;
+
+/* A page of a file in the page cache. */
+struct pcache_page
+  {
+    block_sector_t inumber;     /* File's inode sector. */
+    size_t index;               /* Page within the file. */
+    struct frame *frame;        /* Frame holding the data. */
+    int pin_cnt;                /* Users keeping it from eviction. */
+    bool referenced;            /* Read since the clock last came by? */
+    bool dead;                  /* Dropped, about to be freed. */
+    struct list mappers;        /* Pages mapping the frame. */
+    struct hash_elem hash_elem; /* Element in the cache. */
+    struct list_elem drop_elem; /* Element in pcache_drop()'s list. */
+  };
+
+void pcache_init (void);
+struct pcache_page *pcache_get (struct inode *, size_t index, bool evict,
+                                bool *miss);
+void pcache_put (struct pcache_page *);
+bool pcache_map (struct pcache_page *, struct page *);
+void pcache_unmap (struct page *);
+bool pcache_is_mapped (const struct page *);
+bool pcache_try_evict (struct pcache_page *);
+
+off_t pcache_read (struct inode *, void *, off_t size, off_t offset);
+void pcache_write (struct inode *, const void *, off_t size, off_t offset);
+void pcache_drop (block_sector_t inumber);
+void pcache_print_stats (void);
+
+#endif /* vm/pcache.h */
@@ -0,0 +1,172 @@
+#include "vm/stats.h"
+#include <stdio.h>
+#include "threads/thread.h"
+
+/* System-wide statistics. */
+static struct vm_stats global_stats;
+
+/* -vmstat: Report each process's statistics when it exits. */
+bool vm_stats_per_process;
+
+/* Reads the processor's time stamp counter. */
+static inline uint64_t
+read_tsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the histogram bucket for a fault that took CYCLES. */
+static int
+time_bucket (uint64_t cycles) 
+{
+  int bucket = 0;
+
+  cycles >>= VM_STATS_SHIFT + 1;
+  while (cycles > 0 && bucket < VM_STATS_BUCKETS - 1) 
+    {
+      cycles >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+/* Counts a fault of the given SOURCE in S.  The caller must
+   have disabled preemption. */
+static void
+count_fault (struct vm_stats *s, enum vm_fault_source source, bool major,
+             int bucket) 
+{
+  s->faults++;
+  switch (source) 
+    {
+    case VM_FAULT_ZERO:
+      s->zero++;
+      break;
+    case VM_FAULT_FILE:
+      s->file++;
+      break;
+    case VM_FAULT_SWAP:
+      s->swap++;
+      break;
+    case VM_FAULT_INVALID:
+      s->invalid++;
+      break;
+    }
+  if (source != VM_FAULT_INVALID)
+    {
+      if (major)
+        s->major++;
+      else
+        s->minor++;
+    }
+  s->fault_time[bucket]++;
+}
+
+/* Marks the start of handling a page fault.  Returns the value
+   to pass to vm_stats_fault_end(). */
+uint64_t
+vm_stats_fault_begin (void) 
+{
+  return read_tsc ();
+}
+
+/* Counts a page fault of the current process, whose handling
+   started at START, as resolved from SOURCE.  MAJOR means the
+   fault had to wait for the page to be read in. */
+void
+vm_stats_fault_end (uint64_t start, enum vm_fault_source source, bool major) 
+{
+  int bucket = time_bucket (read_tsc () - start);
+
+  preempt_disable ();
+  count_fault (&thread_current ()->leader->vm_stats, source, major, bucket);
+  count_fault (&global_stats, source, major, bucket);
+  preempt_enable ();
+}
+
+/* Counts the eviction of a page belonging to OWNER, which had to
+   be written back first if DIRTY. */
+void
+vm_stats_evict (struct thread *owner, bool dirty) 
+{
+  preempt_disable ();
+  if (dirty) 
+    {
+      owner->vm_stats.evict_dirty++;
+      global_stats.evict_dirty++;
+    }
+  else 
+    {
+      owner->vm_stats.evict_clean++;
+      global_stats.evict_clean++;
+    }
+  preempt_enable ();
+}
+
+/* Counts a page of OWNER read from swap. */
+void
+vm_stats_swap_read (struct thread *owner) 
+{
+  preempt_disable ();
+  owner->vm_stats.swap_reads++;
+  global_stats.swap_reads++;
+  preempt_enable ();
+}
+
+/* Counts a page of OWNER written to swap. */
+void
+vm_stats_swap_write (struct thread *owner) 
+{
+  preempt_disable ();
+  owner->vm_stats.swap_writes++;
+  global_stats.swap_writes++;
+  preempt_enable ();
+}
+
+/* Counts PAGES file pages of OWNER read around a fault. */
+void
+vm_stats_read_ahead (struct thread *owner, unsigned long pages) 
+{
+  preempt_disable ();
+  owner->vm_stats.read_ahead += pages;
+  global_stats.read_ahead += pages;
+  preempt_enable ();
+}
+
+/* Prints S, with each line prefixed by NAME. */
+static void
+print_stats (const char *name, const struct vm_stats *s) 
+{
+  int i;
+
+  printf ("%s: %lu page faults (%lu minor, %lu major), "
+          "%lu zero, %lu file, %lu swap, %lu invalid\n",
+          name, s->faults, s->minor, s->major,
+          s->zero, s->file, s->swap, s->invalid);
+  printf ("%s: %lu evictions (%lu clean, %lu dirty), "
+          "%lu swap reads, %lu swap writes, %lu read ahead\n",
+          name, s->evict_clean + s->evict_dirty, s->evict_clean,
+          s->evict_dirty, s->swap_reads, s->swap_writes, s->read_ahead);
+  for (i = 0; i < VM_STATS_BUCKETS; i++)
+    if (s->fault_time[i] != 0)
+      printf ("%s: %lu faults in %s2^%d cycles\n", name, s->fault_time[i],
+              i == 0 ? "< " : ">= ", VM_STATS_SHIFT + i + (i == 0));
+}
+
+/* Prints the statistics of the current process, if -vmstat was
+   given.  Called when the process exits. */
+void
+vm_stats_process_exit (void) 
+{
+  if (vm_stats_per_process)
+    print_stats (thread_name (), &thread_current ()->vm_stats);
+}
+
+/* Prints the system-wide statistics. */
+void
+vm_stats_print (void) 
+{
+  print_stats ("Paging", &global_stats);
+}
@@ -0,0 +1,56 @@
+#ifndef VM_STATS_H
+#define VM_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Where the contents of a faulted-in page came from. */
+enum vm_fault_source
+  {
+    VM_FAULT_ZERO,              /* Zero-filled. */
+    VM_FAULT_FILE,              /* A file or the executable. */
+    VM_FAULT_SWAP,              /* The swap device. */
+    VM_FAULT_INVALID            /* Bad access, the process is killed. */
+  };
+
+/* Fault handling time histogram.  Bucket 0 counts faults handled
+   in fewer than 2**(VM_STATS_SHIFT + 1) cycles, bucket I > 0 those
+   that took 2**(VM_STATS_SHIFT + I) cycles or more, up to twice
+   that.  The last bucket also counts everything longer. */
+#define VM_STATS_SHIFT 8
+#define VM_STATS_BUCKETS 20
+
+/* Paging statistics, kept for each process and system-wide. */
+struct vm_stats
+  {
+    unsigned long faults;       /* All page faults. */
+    unsigned long minor;        /* Faults resolved without I/O. */
+    unsigned long major;        /* Faults that had to wait for I/O. */
+    unsigned long zero;         /* Faults by source... */
+    unsigned long file;
+    unsigned long swap;
+    unsigned long invalid;
+    unsigned long evict_clean;  /* Pages evicted without writing. */
+    unsigned long evict_dirty;  /* Pages written back when evicted. */
+    unsigned long swap_reads;   /* Pages read from swap. */
+    unsigned long swap_writes;  /* Pages written to swap. */
+    unsigned long read_ahead;   /* File pages read around a fault. */
+    unsigned long fault_time[VM_STATS_BUCKETS];
+  };
+
+/* -vmstat: Report each process's statistics when it exits. */
+extern bool vm_stats_per_process;
+
+uint64_t vm_stats_fault_begin (void);
+void vm_stats_fault_end (uint64_t start, enum vm_fault_source, bool major);
+void vm_stats_evict (struct thread *owner, bool dirty);
+void vm_stats_swap_read (struct thread *owner);
+void vm_stats_swap_write (struct thread *owner);
+void vm_stats_read_ahead (struct thread *owner, unsigned long pages);
+
+void vm_stats_process_exit (void);
+void vm_stats_print (void);
+
+#endif /* vm/stats.h */
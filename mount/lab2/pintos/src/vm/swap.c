@@ -0,0 +1,94 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/zswap.h"
+
+/* Swap slots are page sized runs of sectors on the swap device.
+   Pages pass through the compressed cache in vm/zswap.c on their
+   way there. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_block;   /* Swap device, if any. */
+static struct bitmap *used_slots;  /* Slots holding a page. */
+static struct lock swap_lock;      /* Protects used_slots. */
+
+static zswap_write_func write_slot;
+
+/* Initializes swap on the swap device.  Without one, every
+   swap_out() fails. */
+void
+swap_init (void) 
+{
+  size_t slot_cnt = 0;
+
+  swap_block = block_get_role (BLOCK_SWAP);
+  if (swap_block != NULL)
+    slot_cnt = block_size (swap_block) / SECTORS_PER_SLOT;
+  used_slots = bitmap_create (slot_cnt);
+  if (used_slots == NULL)
+    PANIC ("bitmap creation failed--swap device is too large");
+  lock_init (&swap_lock);
+  zswap_init (slot_cnt, write_slot);
+}
+
+/* Writes the page at KPAGE to SLOT on the device. */
+static void
+write_slot (size_t slot, const void *kpage) 
+{
+  const uint8_t *p = kpage;
+  int i;
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_write (swap_block, slot * SECTORS_PER_SLOT + i,
+                 p + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Writes the page at KPAGE to a free swap slot.  Returns the
+   slot, or SWAP_ERROR if swap is full. */
+size_t
+swap_out (const void *kpage) 
+{
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (used_slots, 0, 1, false);
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_ERROR;
+
+  if (!zswap_store (slot, kpage))
+    write_slot (slot, kpage);
+  return slot;
+}
+
+/* Reads the page in SLOT into KPAGE.  The slot stays in use.
+   Returns true if it had to be read from the device, false if
+   the swap cache had it. */
+bool
+swap_in (size_t slot, void *kpage) 
+{
+  uint8_t *p = kpage;
+  int i;
+
+  ASSERT (bitmap_test (used_slots, slot));
+  if (zswap_load (slot, kpage))
+    return false;
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_read (swap_block, slot * SECTORS_PER_SLOT + i,
+                p + i * BLOCK_SECTOR_SIZE);
+  return true;
+}
+
+/* Makes SLOT available again. */
+void
+swap_free (size_t slot) 
+{
+  zswap_invalidate (slot);
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  bitmap_reset (used_slots, slot);
+  lock_release (&swap_lock);
+}
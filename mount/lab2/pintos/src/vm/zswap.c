@@ -0,0 +1,376 @@
+#include "vm/zswap.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/workqueue.h"
+#include "vm/lz.h"
+
+/* Compressed swap cache.
+
+   Pages on their way to swap are compressed (see vm/lz.c) into a
+   pool of kernel pages instead of being written out.  A page only
+   reaches the swap device if it compresses poorly or, when the
+   pool is full, once it is the least recently stored page in the
+   pool.  Every page still owns its swap slot, which is where it
+   goes when spilled, so the cache never limits how much can be
+   swapped.
+
+   The pool is laid out like Linux's zbud: each pool page holds at
+   most two compressed pages, one at its start and one at its end.
+   That wastes some room but needs no compaction.
+
+   The pool gives its empty pages back to the kernel pool when
+   that runs dry, and takes them again as it needs room and the
+   kernel pool has some to spare.  Emptying a page means writing
+   what it holds to the device, which must not happen inside the
+   failed allocation that asked for it, so that is left to a work
+   item on system_wq. */
+
+/* Pages that compress to more than this go straight to the
+   device. */
+#define MAX_STORED (PGSIZE * 3 / 4)
+
+/* -zswap: Pool size. */
+size_t zswap_pool_pages = 64;
+
+/* A pool page.  Buddy 0 sits at its start, buddy 1 at its end. */
+struct zpage
+  {
+    uint16_t size[2];           /* Bytes used by each buddy, 0 if free. */
+  };
+
+/* A swap slot's place in the cache. */
+struct zentry
+  {
+    bool cached;                /* In the pool? */
+    uint8_t buddy;              /* Which half of the pool page. */
+    uint16_t zpage;             /* Pool page. */
+    struct list_elem lru_elem;  /* Element in lru. */
+  };
+
+static uint8_t **pool;          /* Pool pages, null if given back. */
+static struct zpage *zpages;    /* Their use. */
+static size_t pool_cnt;         /* Size of pool, 0 if disabled. */
+static size_t present_cnt;      /* Pool pages not given back. */
+static struct zentry *entries;  /* One for each swap slot. */
+static struct list lru;         /* Cached entries, newest first. */
+static uint8_t *compressed;     /* Output of compression. */
+static uint8_t *spill_page;     /* A page on its way to the device. */
+static zswap_write_func *write_slot;
+static size_t shrink_wanted;    /* Pool pages the shrinker wants back. */
+static struct lock zswap_lock;  /* Protects all of the above. */
+
+static struct shrinker zswap_shrinker;
+static struct work shrink_work;
+static work_func shrink_pool;
+
+/* Statistics. */
+static unsigned long stores;    /* Pages stored in the pool. */
+static unsigned long rejects;   /* Pages sent straight to the device. */
+static unsigned long spills;    /* Pages pushed out to the device. */
+static unsigned long hits;      /* Loads served from the pool. */
+static unsigned long misses;    /* Loads that had to read the device. */
+static unsigned long long bytes_in, bytes_out;
+
+/* Sets up a cache in front of a swap device with SLOT_CNT slots,
+   writing spilled pages with WRITE. */
+void
+zswap_init (size_t slot_cnt, zswap_write_func *write)
+{
+  size_t i;
+
+  lock_init (&zswap_lock);
+  list_init (&lru);
+  work_init (&shrink_work, shrink_pool, NULL);
+  write_slot = write;
+  if (zswap_pool_pages == 0 || slot_cnt == 0)
+    return;
+
+  entries = malloc (slot_cnt * sizeof *entries);
+  pool = malloc (zswap_pool_pages * sizeof *pool);
+  zpages = calloc (zswap_pool_pages, sizeof *zpages);
+  compressed = palloc_get_page (0);
+  spill_page = palloc_get_page (0);
+  if (entries == NULL || pool == NULL || zpages == NULL
+      || compressed == NULL || spill_page == NULL)
+    PANIC ("out of memory for swap cache");
+  for (i = 0; i < slot_cnt; i++)
+    entries[i].cached = false;
+
+  /* Pages are taken as they are needed. */
+  pool_cnt = zswap_pool_pages;
+  for (i = 0; i < pool_cnt; i++)
+    pool[i] = NULL;
+  palloc_register_shrinker (&zswap_shrinker);
+}
+
+/* Returns where E's compressed page is. */
+static uint8_t *
+buddy_addr (const struct zentry *e)
+{
+  const struct zpage *z = &zpages[e->zpage];
+  return pool[e->zpage] + (e->buddy == 0 ? 0 : PGSIZE - z->size[1]);
+}
+
+/* Returns the size of E's compressed page. */
+static size_t
+buddy_size (const struct zentry *e)
+{
+  return zpages[e->zpage].size[e->buddy];
+}
+
+/* Finds room for LEN bytes and gives it to E, taking another
+   page for the pool if there is none.  Returns false if no pool
+   page has room and no page could be had. */
+static bool
+pool_alloc (struct zentry *e, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < pool_cnt; i++)
+    {
+      struct zpage *z = &zpages[i];
+      int buddy;
+
+      if (pool[i] == NULL || z->size[0] + z->size[1] + len > PGSIZE)
+        continue;
+      else if (z->size[0] == 0)
+        buddy = 0;
+      else if (z->size[1] == 0)
+        buddy = 1;
+      else
+        continue;
+
+      z->size[buddy] = len;
+      e->zpage = i;
+      e->buddy = buddy;
+      e->cached = true;
+      return true;
+    }
+
+  for (i = 0; i < pool_cnt; i++)
+    if (pool[i] == NULL)
+      {
+        pool[i] = palloc_get_page (0);
+        if (pool[i] == NULL)
+          return false;
+        present_cnt++;
+        zpages[i].size[0] = len;
+        e->zpage = i;
+        e->buddy = 0;
+        e->cached = true;
+        return true;
+      }
+  return false;
+}
+
+/* Gives pool page I back to the kernel pool if it is empty.
+   Returns true if it did. */
+static bool
+pool_release (size_t i)
+{
+  if (pool[i] == NULL || zpages[i].size[0] != 0 || zpages[i].size[1] != 0)
+    return false;
+  palloc_free_page (pool[i]);
+  pool[i] = NULL;
+  present_cnt--;
+  return true;
+}
+
+/* Releases E's room in the pool.  E must already be off lru. */
+static void
+pool_free (struct zentry *e)
+{
+  zpages[e->zpage].size[e->buddy] = 0;
+  e->cached = false;
+}
+
+/* Decompresses E's page into PAGE. */
+static void
+decompress (const struct zentry *e, void *page)
+{
+  if (!lz_decompress (buddy_addr (e), buddy_size (e), page, PGSIZE))
+    PANIC ("swap cache corrupted");
+}
+
+/* Writes the least recently stored page out to its slot and
+   releases its room.  Returns the pool page it was in. */
+static size_t
+spill_oldest (void)
+{
+  struct zentry *e = list_entry (list_pop_back (&lru),
+                                 struct zentry, lru_elem);
+
+  decompress (e, spill_page);
+  pool_free (e);
+  write_slot (e - entries, spill_page);
+  spills++;
+  return e->zpage;
+}
+
+/* Shrinker: the pool pages could all be given back. */
+static size_t
+zswap_count (void)
+{
+  return present_cnt;
+}
+
+/* Shrinker: gives back up to PAGE_CNT pool pages that are
+   already empty.  If that is not enough, queues shrink_pool() to
+   spill pages and free the rest later, since spilling means I/O,
+   which has no place inside palloc_get_multiple(). */
+static size_t
+zswap_scan (size_t page_cnt)
+{
+  size_t freed = 0;
+  size_t i;
+
+  if (lock_held_by_current_thread (&zswap_lock)
+      || !lock_try_acquire (&zswap_lock))
+    return 0;
+  for (i = 0; i < pool_cnt && freed < page_cnt; i++)
+    if (pool_release (i))
+      freed++;
+  if (freed < page_cnt && !list_empty (&lru))
+    {
+      shrink_wanted += page_cnt - freed;
+      if (shrink_wanted > present_cnt)
+        shrink_wanted = present_cnt;
+      work_queue (system_wq, &shrink_work);
+    }
+  lock_release (&zswap_lock);
+  return freed;
+}
+
+/* Spills the oldest pages until the pool has given back the
+   pages the shrinker asked for. */
+static void
+shrink_pool (struct work *w UNUSED)
+{
+  lock_acquire (&zswap_lock);
+  while (shrink_wanted > 0 && !list_empty (&lru))
+    if (pool_release (spill_oldest ()))
+      shrink_wanted--;
+  shrink_wanted = 0;
+  lock_release (&zswap_lock);
+}
+
+static struct shrinker zswap_shrinker =
+  {
+    .name = "zswap",
+    .priority = 10,
+    .user = false,
+    .count = zswap_count,
+    .scan = zswap_scan,
+  };
+
+/* Stores the page at KPAGE, which belongs in SLOT, in the cache,
+   making room if need be.  Returns false if the cache is
+   disabled or the page does not compress well enough; the caller
+   must then write it to the device. */
+bool
+zswap_store (size_t slot, const void *kpage)
+{
+  struct zentry *e = &entries[slot];
+  size_t len;
+
+  if (pool_cnt == 0)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  ASSERT (!e->cached);
+  len = lz_compress (kpage, PGSIZE, compressed, MAX_STORED);
+  if (len == 0)
+    {
+      rejects++;
+      lock_release (&zswap_lock);
+      return false;
+    }
+
+  /* An empty pool page always has room.  If the shrinker gave
+     every page back and there are none to be had, give up. */
+  while (!pool_alloc (e, len))
+    {
+      if (list_empty (&lru))
+        {
+          rejects++;
+          lock_release (&zswap_lock);
+          return false;
+        }
+      spill_oldest ();
+    }
+  memcpy (buddy_addr (e), compressed, len);
+  list_push_front (&lru, &e->lru_elem);
+
+  stores++;
+  bytes_in += PGSIZE;
+  bytes_out += len;
+  lock_release (&zswap_lock);
+  return true;
+}
+
+/* Reads SLOT's page into KPAGE if it is in the cache.  Returns
+   false if it has to be read from the device instead. */
+bool
+zswap_load (size_t slot, void *kpage)
+{
+  struct zentry *e = &entries[slot];
+  bool hit;
+
+  if (pool_cnt == 0)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  hit = e->cached;
+  if (hit)
+    {
+      decompress (e, kpage);
+      hits++;
+    }
+  else
+    misses++;
+  lock_release (&zswap_lock);
+  return hit;
+}
+
+/* Drops SLOT's page from the cache, if it is there.  Called when
+   the slot is freed. */
+void
+zswap_invalidate (size_t slot)
+{
+  struct zentry *e = &entries[slot];
+
+  if (pool_cnt == 0)
+    return;
+
+  lock_acquire (&zswap_lock);
+  if (e->cached)
+    {
+      list_remove (&e->lru_elem);
+      pool_free (e);
+    }
+  lock_release (&zswap_lock);
+}
+
+/* Prints cache statistics. */
+void
+zswap_print_stats (void)
+{
+  unsigned long loads = hits + misses;
+  unsigned long long ratio = bytes_out > 0 ? bytes_in * 100 / bytes_out : 0;
+
+  if (pool_cnt == 0)
+    return;
+  printf ("Swap cache: %zu of %zu pool pages, %lu stored, %lu rejected, "
+          "%lu spilled\n", present_cnt, pool_cnt, stores, rejects, spills);
+  printf ("Swap cache: %lu of %lu loads hit (%lu%%), "
+          "compression %llu.%02llu:1\n",
+          hits, loads, loads > 0 ? hits * 100 / loads : 0,
+          ratio / 100, ratio % 100);
+}
@@ -0,0 +1,19 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Writes PAGE to SLOT on the swap device. */
+typedef void zswap_write_func (size_t slot, const void *page);
+
+/* -zswap: Kernel pages to give the compressed pool. */
+extern size_t zswap_pool_pages;
+
+void zswap_init (size_t slot_cnt, zswap_write_func *);
+bool zswap_store (size_t slot, const void *kpage);
+bool zswap_load (size_t slot, void *kpage);
+void zswap_invalidate (size_t slot);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */